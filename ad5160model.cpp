@@ -0,0 +1,55 @@
+/* AD5160 model class - Version 1.0.0
+   Requires CP2130 emulator class version 1.0.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include "ad5160model.h"
+
+// The wiper starts at midscale, as it does on power-up
+AD5160Model::AD5160Model() :
+    selected_(false),
+    code_(0x80),
+    shift_(0x80)
+{
+}
+
+// Returns the wiper code latched by the last complete write
+uint8_t AD5160Model::code() const
+{
+    return code_;
+}
+
+// Latches the shifted byte into the wiper register on the rising edge of !CS
+void AD5160Model::select(bool selected)
+{
+    if (selected_ && !selected) {
+        code_ = shift_;
+    }
+    selected_ = selected;
+}
+
+// Shifts in one byte (only the last byte sent before !CS rises is latched, and the SDO pin is not modelled)
+uint8_t AD5160Model::transfer(uint8_t mosi)
+{
+    if (selected_) {
+        shift_ = mosi;
+    }
+    return 0x00;
+}
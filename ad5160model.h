@@ -0,0 +1,44 @@
+/* AD5160 model class - Version 1.0.0
+   Requires CP2130 emulator class version 1.0.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef AD5160MODEL_H
+#define AD5160MODEL_H
+
+// Includes
+#include <cstdint>
+#include "cp2130emulator.h"
+
+class AD5160Model : public CP2130Emulator::SPISlave
+{
+private:
+    bool selected_;
+    uint8_t code_, shift_;
+
+public:
+    AD5160Model();
+
+    uint8_t code() const;
+
+    void select(bool selected) override;
+    uint8_t transfer(uint8_t mosi) override;
+};
+
+#endif  // AD5160MODEL_H
@@ -0,0 +1,169 @@
+/* AD5932 model class - Version 1.0.0
+   Requires CP2130 emulator class version 1.0.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include "ad5932model.h"
+#include "timesource.h"
+
+// Definitions
+const uint16_t SINE = 0x0200;         // Mask for the waveform bit of the control register (sinusoidal waveform if set)
+const uint16_t DFNEG = 0x0800;        // Mask for the sign bit of the delta frequency MSBs register (negative increments)
+const uint16_t TINTMCLK = 0x2000;     // Mask for the increment interval mode bit (interval given in MCLK periods)
+const double FQUANTUM = 16777216;     // Quantum related to the 24-bit frequency resolution
+const double MCLK = 50000;            // 50MHz clock (frequencies are expressed in kHz)
+const uint TINTMULTIPLIERS[4] = {1, 5, 100, 500};  // Increment interval multipliers
+
+// Private procedure that decodes a 16-bit word written to the AD5932, according to the address given by its four most significant bits
+void AD5932Model::writeRegister(uint16_t word)
+{
+    switch (word >> 12) {
+        case 0x0:  // Control register
+            control_ = word;
+            break;
+        case 0x1:  // Number of increments register
+            nincr_ = static_cast<uint16_t>(0x0fff & word);
+            break;
+        case 0x2:  // Delta frequency LSBs register
+            deltaf_ = (0xfff000 & deltaf_) | (0x000fff & word);
+            break;
+        case 0x3:  // Delta frequency MSBs register, including the sign bit
+            deltaf_ = (0x800fff & deltaf_) | static_cast<uint32_t>(0x07ff & word) << 12 | ((DFNEG & word) != 0x0000 ? 0x800000 : 0x000000);
+            break;
+        case 0x4:  // Increment interval register (all four addresses are used, since bits D13 to D11 are part of the register)
+        case 0x5:
+        case 0x6:
+        case 0x7:
+            tint_ = word;
+            break;
+        case 0xc:  // Fstart LSBs register
+            fstart_ = (0xfff000 & fstart_) | (0x000fff & word);
+            break;
+        case 0xd:  // Fstart MSBs register
+            fstart_ = (0x000fff & fstart_) | static_cast<uint32_t>(0x0fff & word) << 12;
+            break;
+    }
+}
+
+// The model starts with all registers cleared and no output
+AD5932Model::AD5932Model(uint16_t ctrlBitmap, uint16_t interruptBitmap) :
+    ctrlBitmap_(ctrlBitmap),
+    interruptBitmap_(interruptBitmap),
+    gpioValues_(0x0000),
+    selected_(false),
+    msbLatched_(false),
+    msb_(0x00),
+    control_(0x0000),
+    nincr_(0x0000),
+    tint_(0x0000),
+    deltaf_(0x000000),
+    fstart_(0x000000),
+    generating_(false),
+    start_(),
+    clock_(&TimeSource::steady())  // Real time is followed until the model is attached to an emulated device
+{
+}
+
+// Returns the output frequency (in kHz) at the given time (in seconds) after the "CTRL" rising edge, or zero if there is no output
+// The frequency holds at its final value once all increments are complete
+float AD5932Model::frequencyAt(double seconds) const
+{
+    double frequency = 0;
+    if (generating_) {
+        double fstart = MCLK * fstart_ / FQUANTUM;
+        double deltaf = MCLK * (0x7fffff & deltaf_) / FQUANTUM;
+        if ((0x800000 & deltaf_) != 0x000000) {
+            deltaf = -deltaf;
+        }
+        double interval = (0x07ff & tint_) * TINTMULTIPLIERS[0x03 & tint_ >> 11];  // In MCLK periods or in waveform cycles
+        uint16_t increment = 0;
+        double boundary = 0;
+        frequency = fstart;
+        while (increment < nincr_ && interval > 0) {  // Walk through the increments, since the interval may depend on the current frequency
+            boundary += (TINTMCLK & tint_) != 0x0000 ? interval / (1000 * MCLK) : (frequency > 0 ? interval / (1000 * frequency) : 0);
+            if (seconds < boundary) {
+                break;
+            }
+            frequency += deltaf;
+            ++increment;
+        }
+    }
+    return static_cast<float>(frequency);
+}
+
+// Checks if the model is generating a waveform, i.e., if a "CTRL" rising edge was seen and no "INTERRUPT" rising edge followed
+bool AD5932Model::isGenerating() const
+{
+    return generating_;
+}
+
+// Checks if the waveform is sinusoidal (as opposed to triangular)
+bool AD5932Model::isSine() const
+{
+    return (SINE & control_) != 0x0000;
+}
+
+// Returns the time elapsed (in seconds) since the last "CTRL" rising edge
+double AD5932Model::elapsed() const
+{
+    return std::chrono::duration<double>(clock_->now() - start_).count();
+}
+
+// Follows the "CTRL" and "INTERRUPT" signals, starting the output on a "CTRL" rising edge and halting it on an "INTERRUPT" rising edge
+void AD5932Model::gpio(uint16_t values)
+{
+    bool ctrlRising = (ctrlBitmap_ & gpioValues_) == 0x0000 && (ctrlBitmap_ & values) != 0x0000;
+    bool interruptRising = (interruptBitmap_ & gpioValues_) == 0x0000 && (interruptBitmap_ & values) != 0x0000;
+    if (interruptRising) {
+        generating_ = false;
+    }
+    if (ctrlRising) {
+        generating_ = true;
+        start_ = clock_->now();
+    }
+    gpioValues_ = values;
+}
+
+// Follows the "FSYNC" signal, which frames each 16-bit word
+void AD5932Model::select(bool selected)
+{
+    selected_ = selected;
+    msbLatched_ = false;
+}
+
+// Follows the given clock, which is the clock of the emulated device the model is attached to
+void AD5932Model::setTimeSource(const TimeSource &clock)
+{
+    clock_ = &clock;
+}
+
+// Receives one byte, MSB first, decoding each complete 16-bit word (the AD5932 has no serial output, so MISO stays low)
+uint8_t AD5932Model::transfer(uint8_t mosi)
+{
+    if (selected_) {
+        if (msbLatched_) {
+            writeRegister(static_cast<uint16_t>(msb_ << 8 | mosi));
+        } else {
+            msb_ = mosi;
+        }
+        msbLatched_ = !msbLatched_;
+    }
+    return 0x00;
+}
@@ -0,0 +1,59 @@
+/* AD5932 model class - Version 1.0.0
+   Requires CP2130 emulator class version 1.0.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef AD5932MODEL_H
+#define AD5932MODEL_H
+
+// Includes
+#include <chrono>
+#include <cstdint>
+#include "cp2130emulator.h"
+
+class AD5932Model : public CP2130Emulator::SPISlave
+{
+private:
+    uint16_t ctrlBitmap_, interruptBitmap_;
+    uint16_t gpioValues_;
+    bool selected_, msbLatched_;
+    uint8_t msb_;
+    uint16_t control_, nincr_, tint_;
+    uint32_t deltaf_, fstart_;
+    bool generating_;
+    std::chrono::steady_clock::time_point start_;
+    const TimeSource *clock_;
+
+    void writeRegister(uint16_t word);
+
+public:
+    AD5932Model(uint16_t ctrlBitmap, uint16_t interruptBitmap);
+
+    double elapsed() const;
+    float frequencyAt(double seconds) const;
+    bool isGenerating() const;
+    bool isSine() const;
+
+    void gpio(uint16_t values) override;
+    void select(bool selected) override;
+    void setTimeSource(const TimeSource &clock) override;
+    uint8_t transfer(uint8_t mosi) override;
+};
+
+#endif  // AD5932MODEL_H
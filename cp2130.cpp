@@ -1,4 +1,4 @@
-/* CP2130 class - Version 1.2.5
+/* CP2130 class - Version 1.3.0
    Copyright (c) 2021-2022 Samuel Lourenço
 
    This library is free software: you can redistribute it and/or modify it
@@ -19,10 +19,27 @@
 
 
 // Includes
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
-#include <iomanip>
-#include <sstream>
+#include <ctime>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__  // The usbfs backend, the hand-off of devices and the autosuspend control are specific to Linux (since version 1.3.0)
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <linux/usbdevice_fs.h>
+#endif
 #include "cp2130.h"
+#include "timesource.h"
 extern "C" {
 #include "libusb-extra.h"
 }
@@ -30,11 +47,74 @@ extern "C" {
 // Definitions
 const unsigned int TR_TIMEOUT = 500;  // Transfer timeout in milliseconds
 
+// Size of the fixed buffers used to format error messages and device node paths, which are written via std::snprintf() instead of string streams, so that the library does not depend on iostreams (added in version 1.3.0)
+const size_t MSG_BUFFER_SIZE = 80;
+
 // Specific to getDescGeneric() and writeDescGeneric() (added in version 1.1.0)
 const uint16_t DESC_TBLSIZE = 0x0040;          // Descriptor table size, including preamble [64]
 const size_t DESC_MAXIDX = DESC_TBLSIZE - 2;   // Maximum usable index [62]
 const size_t DESC_IDXINCR = DESC_TBLSIZE - 1;  // Index increment or step between table preambles [63]
 
+// Specific to handOff() and takeOver() (added in version 1.3.0)
+const uint8_t HOFLAG_KERNEL = 0x01;  // Flag that signals that a kernel driver was attached to the interface before the device was first opened
+
+// Specific to recover() (added in version 1.3.0)
+const int RCV_TIMEOUT = 5000;  // Time allowed for the device to re-enumerate after being reset, in milliseconds
+const int RCV_RETRY = 100;     // Interval between attempts to reopen the device, in milliseconds
+
+// Specific to the timing model (added in version 1.3.0)
+const double SPI_MAXCLK = 12000000;  // Maximum SPI clock frequency (12MHz), which is halved by each increment of the clock frequency value
+const double TM_CTRLTIME = 1000;     // Default duration of a control transfer [1ms]
+const double TM_BULKTIME = 1000;     // Default fixed duration of a bulk transfer [1ms]
+const double TM_BYTETIME = 1;        // Default duration per byte of a bulk transfer [1us]
+
+#ifdef __linux__
+// Specific to the idle guard (added in version 1.3.0)
+const unsigned int USB_DEVICE_MAJOR = 189;  // Major number of the usbfs device nodes, whose minor number is given by the bus number and the device address
+
+#endif
+
+// Specific to listDevices() (added in version 1.3.0)
+const size_t LST_THREADS = 4;         // Maximum number of devices that are probed concurrently
+const unsigned int LST_TIMEOUT = 500;  // Time allowed for reading the serial number of each device, in milliseconds
+
+// Specific to LatencyStats (added in version 1.3.0)
+const size_t LAT_SUBBUCKETS = 8;  // Number of buckets per octave
+
+// Specific to Profiler (added in version 1.3.0)
+thread_local const CP2130::Profiler *currentProfiler = nullptr;  // Profiler of the outermost operation being measured on the current thread, if any
+thread_local const CP2130 *profiledDevice = nullptr;              // Device of that operation, whose transfers are counted below
+thread_local uint64_t profiledTransfers = 0;                      // Number of transfers issued to that device by the current thread
+thread_local uint64_t profiledBytes = 0;                          // Number of bytes exchanged by those transfers
+
+#ifdef __linux__
+// Specific to the usbfs backend (added in version 1.3.0)
+const size_t URB_POOL = 16;                                     // Number of URBs that can be pending during a transfer batch (an additional URB is reserved for synchronous transfers)
+const size_t URB_SETUP_SIZE = 8;                                // Size of the setup packet that precedes the data stage of a control URB
+const size_t URB_DATA_SIZE = 64;                                // Maximum data stage length of a control URB, which covers every CP2130 command
+const size_t URB_BUFFER_SIZE = URB_SETUP_SIZE + URB_DATA_SIZE;  // Size of the buffer preallocated for each control URB
+#endif
+
+// Returns the CPU time spent by the calling thread (in us)
+static double threadCPUTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return 1e6 * static_cast<double>(ts.tv_sec) + 1e-3 * static_cast<double>(ts.tv_nsec);
+}
+
+// Private procedure that applies the idle policy to the open device, by disabling autosuspend and by starting the keepalive thread, as required (added in version 1.3.0)
+void CP2130::applyIdlePolicy(int &errcnt, std::string &errstr)
+{
+    if (idlepolicy_.noautosuspend && backend_ != BACKEND_TRANSPORT) {  // A transport has no sysfs entry
+        setAutosuspend(false, errcnt, errstr);
+    }
+    if (idlepolicy_.keepalive > 0 && !kaThread_.joinable()) {
+        kaQuit_ = false;
+        kaThread_ = std::thread(&CP2130::runKeepalive, this);
+    }
+}
+
 // Private generic procedure used to get any descriptor (added as a refactor in version 1.1.0)
 std::u16string CP2130::getDescGeneric(uint8_t command, int &errcnt, std::string &errstr)
 {
@@ -88,6 +168,799 @@ void CP2130::writeDescGeneric(const std::u16string &descriptor, uint8_t command,
     }
 }
 
+// Private procedure that counts a transfer issued by the calling thread, if the operation being profiled on that thread belongs to this device (added in version 1.3.0)
+// Per-thread counters are used, so that transfers issued by other threads (e.g., the keepalive thread) are not charged to the operation
+void CP2130::profileTransfer(uint64_t bytes) const
+{
+    if (profiledDevice == this) {
+        ++profiledTransfers;
+        profiledBytes += bytes;
+    }
+}
+
+// Private procedure that releases the transfer buffer, if it was allocated from device memory (added in version 1.3.0)
+// Must be called before the device is closed, since device memory is tied to the open device
+void CP2130::releaseBuffer()
+{
+    if (devmem_ != nullptr) {
+        if (backend_ == BACKEND_USBFS) {
+#ifdef __linux__
+            munmap(devmem_, devmemSize_);
+#endif
+        } else {
+#if LIBUSB_API_VERSION >= 0x01000105
+            libusb_dev_mem_free(handle_, devmem_, devmemSize_);
+#endif
+        }
+        devmem_ = nullptr;
+        devmemSize_ = 0;
+    }
+}
+
+// Private procedure that issues a keepalive transfer whenever the device sits idle for longer than the keepalive interval, run by its own thread (added in version 1.3.0)
+// Keepalives are skipped while the device is in use by another thread, or while anything is pending, since the device is not idle in that case
+void CP2130::runKeepalive()
+{
+    while (!kaQuit_) {
+        double wait = idlepolicy_.keepalive;
+        {
+            std::unique_lock<std::recursive_mutex> iolock(ioMutex_, std::try_to_lock);
+            if (iolock.owns_lock() && isOpen() && !disconnected_) {
+                double idle = std::chrono::duration<double>(clock_->now() - lastActivity_).count();
+                if (idle < idlepolicy_.keepalive) {
+                    wait = idlepolicy_.keepalive - idle;  // Wait until the device is due for a keepalive
+                } else if (!gpioBatching_ && !trfBatching_ && urbsPending_ == 0 && wcPending_.empty()) {
+                    int errcnt = 0;  // Errors are accounted for in the transfer statistics, and any disconnection is reported via disconnected()
+                    std::string errstr;
+                    unsigned char controlBufferIn[GET_GPIO_VALUES_WLEN];
+                    inKeepalive_ = true;
+                    controlTransfer(GET, GET_GPIO_VALUES, 0x0000, 0x0000, controlBufferIn, GET_GPIO_VALUES_WLEN, errcnt, errstr);  // Get_GPIO_Values is one of the cheapest requests, and it has no side effects
+                    inKeepalive_ = false;
+                    ++stats_.keepalives;
+                }
+            }
+        }
+        std::unique_lock<std::mutex> lock(kaMutex_);
+        kaCond_.wait_for(lock, std::chrono::duration<double>(wait), [this] {return kaQuit_.load();});
+    }
+}
+
+// Private procedure that stops the keepalive thread, if it is running (added in version 1.3.0)
+void CP2130::stopKeepalive()
+{
+    if (kaThread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(kaMutex_);
+            kaQuit_ = true;
+        }
+        kaCond_.notify_all();
+        kaThread_.join();
+    }
+}
+
+#ifdef __linux__
+// Private function that returns the sysfs directory of the open device, or an empty string if there is none (added in version 1.3.0)
+std::string CP2130::sysfsPath() const
+{
+    std::string path;
+    char buffer[MSG_BUFFER_SIZE];
+    struct stat status;
+    if (fd_ != -1 && fstat(fd_, &status) == 0 && S_ISCHR(status.st_mode)) {  // The device node identifies the device (usbfs backend, or device opened via openFD())
+        std::snprintf(buffer, sizeof(buffer), "/sys/dev/char/%u:%u", major(status.st_rdev), minor(status.st_rdev));
+        path = buffer;
+    } else if (handle_ != nullptr) {  // Otherwise, the device node is worked out from the bus number and device address, as the kernel does
+        libusb_device *device = libusb_get_device(handle_);
+        std::snprintf(buffer, sizeof(buffer), "/sys/dev/char/%u:%u", USB_DEVICE_MAJOR, 128 * (libusb_get_bus_number(device) - 1u) + libusb_get_device_address(device) - 1u);
+        path = buffer;
+    }
+    return path;
+}
+#endif
+
+// Private function that returns a buffer having at least the given size, which is reused between transfers (added in version 1.3.0)
+// This avoids one heap allocation per transfer, along with the resulting fragmentation over long periods of operation
+// On Linux, the buffer is allocated from device memory if possible, in which case bulk transfers go from and to it without being copied by the kernel. Otherwise, it falls back to the heap
+unsigned char *CP2130::reserveBuffer(size_t size)
+{
+    size_t capacity = devmem_ != nullptr ? devmemSize_ : buffer_.size();
+    if (capacity < size) {  // The buffer only grows
+        releaseBuffer();
+        if (backend_ == BACKEND_USBFS) {  // Device memory is obtained by mapping the usbfs device node, which is what libusb_dev_mem_alloc() does as well
+#ifdef __linux__
+            void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (mapped != MAP_FAILED) {
+                devmem_ = static_cast<unsigned char *>(mapped);
+            }
+#endif
+        } else if (backend_ == BACKEND_LIBUSB) {
+#if LIBUSB_API_VERSION >= 0x01000105
+            devmem_ = libusb_dev_mem_alloc(handle_, size);  // Returns a null pointer if not supported by the platform or by the kernel
+#endif
+        }
+        if (devmem_ != nullptr) {
+            devmemSize_ = size;
+            std::vector<unsigned char>().swap(buffer_);  // The heap buffer is no longer needed
+            ++stats_.devallocs;
+        } else {
+            buffer_.resize(size);
+        }
+        ++stats_.allocs;
+    }
+    return devmem_ != nullptr ? devmem_ : buffer_.data();
+}
+
+#ifdef __linux__
+// Private function that carries out a bulk transfer via usbfs, returning the same values as libusb_bulk_transfer() (added in version 1.3.0)
+int CP2130::usbfsBulkTransfer(uint8_t endpointAddr, unsigned char *data, int length, int *transferred)
+{
+    usbdevfs_urb *urb = &urbs_[URB_POOL];  // The last URB is reserved for synchronous transfers
+    std::memset(urb, 0, sizeof(usbdevfs_urb));
+    urb->type = USBDEVFS_URB_TYPE_BULK;
+    urb->endpoint = endpointAddr;
+    urb->buffer = data;  // The data is transferred directly from or to the given buffer
+    urb->buffer_length = length;
+    int result = usbfsTransfer(urb);
+    *transferred = urb->actual_length;
+    return result < 0 ? result : 0;
+}
+
+// Private function that claims the interface via the usbfs device node, and then allocates the URBs (added in version 1.3.0)
+// Returns SUCCESS, or ERROR_BUSY if the interface is claimed by another process (claiming an interface that is already claimed via the same open file is harmless)
+int CP2130::usbfsClaim()
+{
+    int retval;
+    unsigned int interface = 0;
+    if (ioctl(fd_, USBDEVFS_CLAIMINTERFACE, &interface) != 0) {  // Claim the interface. In case of failure
+        retval = ERROR_BUSY;
+    } else {
+        urbs_ = new usbdevfs_urb[URB_POOL + 1];  // The URBs and their buffers are allocated once, so that no allocations take place per transfer
+        urbBuffers_.resize((URB_POOL + 1) * URB_BUFFER_SIZE);
+        urbsPending_ = 0;
+        retval = SUCCESS;
+    }
+    return retval;
+}
+
+// Private function that releases the interface and closes the usbfs device node, if open (added in version 1.3.0)
+// If "release" is false, the interface is left claimed and the kernel driver is not reattached, as required when the device was handed off to another process
+void CP2130::usbfsClose(bool release)
+{
+    if (fd_ != -1) {
+        if (release) {
+            unsigned int interface = 0;
+            ioctl(fd_, USBDEVFS_RELEASEINTERFACE, &interface);  // Release the interface
+            if (kernelWasAttached_) {  // If a kernel driver was attached to the interface before
+                usbdevfs_ioctl command = {0, USBDEVFS_CONNECT, nullptr};
+                ioctl(fd_, USBDEVFS_IOCTL, &command);  // Reattach the kernel driver
+            }
+        }
+        ::close(fd_);  // Close the device node
+        fd_ = -1;
+    }
+    delete[] urbs_;  // The URBs are freed along with their buffers
+    urbs_ = nullptr;
+    urbBuffers_.clear();
+    urbBuffers_.shrink_to_fit();
+    urbsPending_ = 0;
+}
+
+// Private function that carries out a control transfer via usbfs, returning the same values as libusb_control_transfer() (added in version 1.3.0)
+int CP2130::usbfsControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength)
+{
+    int result;
+    if (wLength > URB_DATA_SIZE) {
+        result = LIBUSB_ERROR_INVALID_PARAM;
+    } else {
+        usbdevfs_urb *urb = usbfsFillControlURB(URB_POOL, bmRequestType, bRequest, wValue, wIndex, data, wLength);  // The last URB is reserved for synchronous transfers
+        result = usbfsTransfer(urb);
+        if (result > 0 && (bmRequestType & LIBUSB_ENDPOINT_IN) != 0) {
+            std::memcpy(data, static_cast<unsigned char *>(urb->buffer) + URB_SETUP_SIZE, static_cast<size_t>(result));  // Copy the data stage to the given buffer
+        }
+    }
+    return result;
+}
+
+// Private function that submits a host-to-device control transfer via usbfs, without waiting for it to complete (added in version 1.3.0)
+// Errors are reported when the transfer is reaped, either by flushTransfers() or by any other synchronous transfer
+void CP2130::usbfsDeferControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength, int &errcnt, std::string &errstr)
+{
+    if (urbsPending_ == URB_POOL) {  // If every URB in the pool is pending, these must be reaped first
+        flushTransfers(errcnt, errstr);
+    }
+    usbdevfs_urb *urb = usbfsFillControlURB(urbsPending_, bmRequestType, bRequest, wValue, wIndex, data, wLength);
+    ++stats_.ctrltrfs;
+    if (ioctl(fd_, USBDEVFS_SUBMITURB, urb) == 0) {
+        ++urbsPending_;
+        stats_.bytesout += wLength;
+        profileTransfer(wLength);
+    } else {
+        ++errcnt;
+        ++stats_.errors;
+        char message[MSG_BUFFER_SIZE];
+        std::snprintf(message, sizeof(message), "Failed control transfer (0x%02x, 0x%02x).\n", bmRequestType, bRequest);
+        errstr += message;
+        if (errno == ENODEV) {
+            disconnected_ = true;  // This reports that the device has been disconnected
+        }
+    }
+}
+
+// Private function that prepares the control URB having the given index in the pool, copying the setup packet and, if applicable, the data stage to its preallocated buffer (added in version 1.3.0)
+usbdevfs_urb *CP2130::usbfsFillControlURB(size_t slot, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const unsigned char *data, uint16_t wLength)
+{
+    usbdevfs_urb *urb = &urbs_[slot];
+    unsigned char *buffer = &urbBuffers_[slot * URB_BUFFER_SIZE];
+    buffer[0] = bmRequestType;  // Setup packet (little-endian fields)
+    buffer[1] = bRequest;
+    buffer[2] = static_cast<uint8_t>(wValue);
+    buffer[3] = static_cast<uint8_t>(wValue >> 8);
+    buffer[4] = static_cast<uint8_t>(wIndex);
+    buffer[5] = static_cast<uint8_t>(wIndex >> 8);
+    buffer[6] = static_cast<uint8_t>(wLength);
+    buffer[7] = static_cast<uint8_t>(wLength >> 8);
+    if ((bmRequestType & LIBUSB_ENDPOINT_IN) == 0 && wLength > 0) {
+        std::memcpy(buffer + URB_SETUP_SIZE, data, wLength);  // Data stage
+    }
+    std::memset(urb, 0, sizeof(usbdevfs_urb));
+    urb->type = USBDEVFS_URB_TYPE_CONTROL;
+    urb->endpoint = 0x00;
+    urb->buffer = buffer;
+    urb->buffer_length = static_cast<int>(URB_SETUP_SIZE + wLength);
+    return urb;
+}
+
+// Private function that opens the usbfs device node corresponding to the device currently open via libusb, and then hands the device over from libusb to usbfs (added in version 1.3.0)
+// Returns the same values as open()
+int CP2130::usbfsOpen()
+{
+    std::string path = usbfsPath();
+    libusb_close(handle_);  // libusb is no longer required, as the device was already found
+    libusb_exit(context_);
+    handle_ = nullptr;
+    int retval;
+    fd_ = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd_ == -1) {  // If the device node could not be opened
+        retval = ERROR_NOT_FOUND;
+    } else {
+        usbdevfs_getdriver driver = {0, {}};
+        if (ioctl(fd_, USBDEVFS_GETDRIVER, &driver) == 0) {  // If a kernel driver is active on the interface
+            usbdevfs_ioctl command = {0, USBDEVFS_DISCONNECT, nullptr};
+            ioctl(fd_, USBDEVFS_IOCTL, &command);  // Detach the kernel driver
+            kernelWasAttached_ = true;  // Flag that the kernel driver was attached
+        } else {
+            kernelWasAttached_ = false;  // The kernel driver was not attached
+        }
+        retval = usbfsClaim();
+        if (retval != SUCCESS && kernelWasAttached_) {  // If the interface could not be claimed, and a kernel driver was attached to the interface before
+            usbdevfs_ioctl command = {0, USBDEVFS_CONNECT, nullptr};
+            ioctl(fd_, USBDEVFS_IOCTL, &command);  // Reattach the kernel driver
+        }
+        if (retval != SUCCESS) {
+            ::close(fd_);  // Close the device node
+            fd_ = -1;  // Required to mark the device as closed
+        }
+    }
+    return retval;
+}
+
+// Private function that returns the path to the usbfs device node corresponding to the device currently open via libusb (added in version 1.3.0)
+std::string CP2130::usbfsPath() const
+{
+    libusb_device *device = libusb_get_device(handle_);
+    char path[MSG_BUFFER_SIZE];
+    std::snprintf(path, sizeof(path), "/dev/bus/usb/%03u/%03u", libusb_get_bus_number(device), libusb_get_device_address(device));
+    return path;
+}
+
+// Private function that waits for any pending URB to complete, up to the given deadline, and then returns it after reaping it (added in version 1.3.0)
+// If no URB is reaped, a null pointer is returned, and "result" is set to the corresponding libusb error code
+usbdevfs_urb *CP2130::usbfsReap(std::chrono::steady_clock::time_point deadline, int &result)
+{
+    usbdevfs_urb *urb = nullptr;
+    result = LIBUSB_SUCCESS;
+    while (urb == nullptr && result == LIBUSB_SUCCESS) {
+        void *reaped = nullptr;
+        if (ioctl(fd_, USBDEVFS_REAPURBNDELAY, &reaped) == 0) {
+            urb = static_cast<usbdevfs_urb *>(reaped);
+        } else if (errno == EAGAIN) {  // No URB has completed yet
+            int remaining = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+            if (remaining < 0) {
+                result = LIBUSB_ERROR_TIMEOUT;
+            } else {
+                pollfd pfd = {fd_, POLLOUT, 0};
+                poll(&pfd, 1, remaining + 1);  // usbfs signals completed URBs as writable events
+            }
+        } else if (errno != EINTR) {
+            result = errno == ENODEV ? LIBUSB_ERROR_NO_DEVICE : LIBUSB_ERROR_IO;
+        }
+    }
+    return urb;
+}
+
+// Private function that submits the given URB and waits for it to complete, returning the same values as the corresponding libusb function (added in version 1.3.0)
+// The URB is discarded if it does not complete within the transfer timeout
+int CP2130::usbfsTransfer(usbdevfs_urb *urb)
+{
+    int result;
+    if (ioctl(fd_, USBDEVFS_SUBMITURB, urb) != 0) {
+        result = errno == ENODEV ? LIBUSB_ERROR_NO_DEVICE : LIBUSB_ERROR_IO;
+    } else {
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TR_TIMEOUT);
+        usbdevfs_urb *reaped;
+        do {
+            reaped = usbfsReap(deadline, result);
+        } while (reaped != nullptr && reaped != urb);  // Any other reaped URB is stale, since pending URBs are always reaped before a synchronous transfer
+        if (reaped == urb) {
+            result = usbfsResult(urb);
+        } else if (result == LIBUSB_ERROR_TIMEOUT) {
+            ioctl(fd_, USBDEVFS_DISCARDURB, urb);  // Discard the URB, and then reap it
+            void *discarded = nullptr;
+            ioctl(fd_, USBDEVFS_REAPURB, &discarded);
+        }
+    }
+    return result;
+}
+#endif
+
+// Private function that carries out a bulk OUT transfer that can be cancelled while in flight via cancel(), returning the same values as libusb_bulk_transfer() (added in version 1.3.0)
+// A cancelled transfer returns LIBUSB_ERROR_INTERRUPTED, and "transferred" is set to the number of bytes that were sent before the cancellation took effect
+int CP2130::streamSegment(uint8_t endpointOutAddr, unsigned char *data, int length, int *transferred)
+{
+    int result;
+    *transferred = 0;
+    std::chrono::steady_clock::time_point start = clock_->now();
+    if (backend_ == BACKEND_USBFS) {
+#ifdef __linux__
+        usbdevfs_urb *urb = &urbs_[URB_POOL];  // The URB reserved for synchronous transfers is used, since no other transfer can be pending at this point
+        std::memset(urb, 0, sizeof(usbdevfs_urb));
+        urb->type = USBDEVFS_URB_TYPE_BULK;
+        urb->endpoint = endpointOutAddr;
+        urb->buffer = data;
+        urb->buffer_length = length;
+        if (ioctl(fd_, USBDEVFS_SUBMITURB, urb) != 0) {
+            result = errno == ENODEV ? LIBUSB_ERROR_NO_DEVICE : LIBUSB_ERROR_IO;
+        } else {
+            {
+                std::lock_guard<std::mutex> guard(streamMutex_);
+                streamURB_ = urb;  // From this point onwards, cancel() discards the URB
+                if (cancelRequested_) {  // Cancelled before the URB could be registered
+                    ioctl(fd_, USBDEVFS_DISCARDURB, urb);
+                }
+            }
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TR_TIMEOUT);
+            usbdevfs_urb *reaped;
+            do {
+                reaped = usbfsReap(deadline, result);
+            } while (reaped != nullptr && reaped != urb);
+            if (reaped != urb && result == LIBUSB_ERROR_TIMEOUT) {
+                ioctl(fd_, USBDEVFS_DISCARDURB, urb);  // Discard the URB, and then reap it
+                void *discarded = nullptr;
+                ioctl(fd_, USBDEVFS_REAPURB, &discarded);
+            } else if (reaped == urb) {
+                result = usbfsResult(urb);
+                result = result < 0 ? result : 0;
+            }
+            {
+                std::lock_guard<std::mutex> guard(streamMutex_);
+                streamURB_ = nullptr;
+            }
+            *transferred = urb->actual_length;
+        }
+#else
+        result = LIBUSB_ERROR_NOT_SUPPORTED;  // Not reached, since the usbfs backend cannot be selected elsewhere
+#endif
+    } else if (backend_ == BACKEND_TRANSPORT) {  // Transports are synchronous, so the stream can only be cancelled between segments
+        result = transport_->bulkTransfer(endpointOutAddr, data, length, transferred);
+    } else {
+        libusb_transfer *transfer = libusb_alloc_transfer(0);
+        int completed = 0;
+        libusb_fill_bulk_transfer(transfer, handle_, endpointOutAddr, data, length, streamCallback, &completed, TR_TIMEOUT);
+        result = libusb_submit_transfer(transfer);
+        if (result == 0) {
+            {
+                std::lock_guard<std::mutex> guard(streamMutex_);
+                streamTransfer_ = transfer;  // From this point onwards, cancel() cancels the transfer
+                if (cancelRequested_) {
+                    libusb_cancel_transfer(transfer);
+                }
+            }
+            while (completed == 0) {
+                libusb_handle_events_completed(context_, &completed);
+            }
+            {
+                std::lock_guard<std::mutex> guard(streamMutex_);
+                streamTransfer_ = nullptr;
+            }
+            *transferred = transfer->actual_length;
+            if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+                result = 0;
+            } else if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
+                result = LIBUSB_ERROR_INTERRUPTED;
+            } else if (transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
+                result = LIBUSB_ERROR_TIMEOUT;
+            } else if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+                result = LIBUSB_ERROR_NO_DEVICE;
+            } else if (transfer->status == LIBUSB_TRANSFER_STALL) {
+                result = LIBUSB_ERROR_PIPE;
+            } else {
+                result = LIBUSB_ERROR_IO;
+            }
+        }
+        libusb_free_transfer(transfer);
+    }
+    stats_.bulklat.add(std::chrono::duration<double, std::micro>(clock_->now() - start).count());
+    ++stats_.bulktrfs;
+    stats_.bytesout += static_cast<uint64_t>(*transferred);
+    profileTransfer(static_cast<uint64_t>(*transferred));
+    if (result != 0 && result != LIBUSB_ERROR_INTERRUPTED) {
+        ++stats_.errors;
+        if (result == LIBUSB_ERROR_NO_DEVICE || result == LIBUSB_ERROR_IO) {
+            disconnected_ = true;  // This reports that the device has been disconnected
+        }
+    }
+    return result;
+}
+
+// Private procedure that writes the given data to the SPI bus, as a single Write command (added in version 1.3.0, based on the previous implementation of spiWrite())
+void CP2130::writeCommand(const uint8_t *data, size_t size, uint8_t endpointOutAddr, int &errcnt, std::string &errstr)
+{
+    uint32_t bytesToWrite = static_cast<uint32_t>(size);
+    int bufSize = bytesToWrite + 8;
+    unsigned char *writeCommandBuffer = reserveBuffer(bufSize);  // Reusable buffer
+    writeCommandBuffer[0] = 0x00;  // Reserved
+    writeCommandBuffer[1] = 0x00;
+    writeCommandBuffer[2] = CP2130::WRITE;  // Write command
+    writeCommandBuffer[3] = 0x00;  // Reserved
+    writeCommandBuffer[4] = static_cast<uint8_t>(bytesToWrite);
+    writeCommandBuffer[5] = static_cast<uint8_t>(bytesToWrite >> 8);
+    writeCommandBuffer[6] = static_cast<uint8_t>(bytesToWrite >> 16);
+    writeCommandBuffer[7] = static_cast<uint8_t>(bytesToWrite >> 24);
+    std::copy(data, data + size, writeCommandBuffer + 8);
+#if LIBUSB_API_VERSION >= 0x01000105
+    bulkTransfer(endpointOutAddr, writeCommandBuffer, bufSize, nullptr, errcnt, errstr);
+#else
+    int bytesWritten;
+    bulkTransfer(endpointOutAddr, writeCommandBuffer, bufSize, &bytesWritten, errcnt, errstr);
+#endif
+}
+
+// Private function that feeds the watchdog with the outcome of a transfer, comparing its latency against the duration predicted by the timing model (added in version 1.3.0)
+// The baselines are exponentially weighted moving averages of the latency ratio and of the error rate, and anomalous transfers are kept out of the latency baseline, so that it does not drift towards a degrading device
+void CP2130::watchdogSample(double latency, double expected, bool failed)
+{
+    if (wdpolicy_.enabled) {
+        double ratio = expected > 0 ? latency / expected : 1;
+        ++wdstatus_.samples;
+        wdstatus_.errrate += wdpolicy_.alpha * ((failed ? 1 : 0) - wdstatus_.errrate);
+        bool anomalous = false;
+        if (wdstatus_.samples > wdpolicy_.warmup) {  // Anomalies are only flagged once the baselines are established
+            double limit = wdstatus_.baseline + wdpolicy_.threshold * wdstatus_.deviation;
+            anomalous = ratio > (limit > wdpolicy_.floor ? limit : wdpolicy_.floor);
+        }
+        if (anomalous) {
+            ++wdstatus_.anomalies;
+            ++wdConsecutive_;
+        } else {
+            double difference = ratio - wdstatus_.baseline;
+            double increment = wdpolicy_.alpha * difference;
+            wdstatus_.baseline = wdstatus_.samples == 1 ? ratio : wdstatus_.baseline + increment;  // The first sample initializes the baseline
+            wdVariance_ = wdstatus_.samples == 1 ? 0 : (1 - wdpolicy_.alpha) * (wdVariance_ + difference * increment);
+            wdstatus_.deviation = std::sqrt(wdVariance_);
+            wdConsecutive_ = 0;
+        }
+        if (!wdstatus_.tripped && wdstatus_.samples > wdpolicy_.warmup && (wdConsecutive_ >= wdpolicy_.consecutive || wdstatus_.errrate > wdpolicy_.maxerrrate)) {
+            wdstatus_.tripped = true;
+            ++wdstatus_.trips;
+        }
+    }
+}
+
+// Private static function that reads the serial number of the given device, used by listDevices() (added in version 1.3.0)
+// Both descriptor requests are bounded by a common deadline, so that a wedged device cannot stall the listing. Returns true if successful
+bool CP2130::probeSerial(libusb_device *device, uint8_t index, std::string &serial)
+{
+    bool success = false;
+    libusb_device_handle *handle;
+    if (index != 0 && libusb_open(device, &handle) == 0) {  // Open the listed device, if it has a serial number. If successfull
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(LST_TIMEOUT);
+        unsigned char langids[4];
+        if (libusb_control_transfer(handle, LIBUSB_ENDPOINT_IN, LIBUSB_REQUEST_GET_DESCRIPTOR, LIBUSB_DT_STRING << 8, 0x0000, langids, static_cast<uint16_t>(sizeof(langids)), LST_TIMEOUT) == static_cast<int>(sizeof(langids))) {  // Get the first supported language ID
+            long long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            unsigned char desc[256];
+            int length = libusb_control_transfer(handle, LIBUSB_ENDPOINT_IN, LIBUSB_REQUEST_GET_DESCRIPTOR, static_cast<uint16_t>(LIBUSB_DT_STRING << 8 | index), static_cast<uint16_t>(langids[3] << 8 | langids[2]), desc, static_cast<uint16_t>(sizeof(desc)), static_cast<unsigned int>(remaining > 0 ? remaining : 1));  // Get the serial number string
+            if (length >= 2 && desc[1] == LIBUSB_DT_STRING) {
+                length = std::min(length, static_cast<int>(desc[0]));
+                for (int i = 2; i + 1 < length; i += 2) {  // Convert the string to ASCII, as libusb_get_string_descriptor_ascii() does
+                    serial += desc[i + 1] == 0x00 && desc[i] < 0x80 ? static_cast<char>(desc[i]) : '?';
+                }
+                success = true;
+            }
+        }
+        libusb_close(handle);  // Close the device
+    }
+    return success;
+}
+
+#ifdef __linux__
+// Private static function that receives a file descriptor over the given Unix domain socket, along with a byte of flags (added in version 1.3.0)
+// Returns the received file descriptor, or -1 in case of failure
+int CP2130::receiveFD(int socket, uint8_t &flags)
+{
+    char control[CMSG_SPACE(sizeof(int))];
+    iovec iov = {&flags, sizeof(flags)};
+    msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    int fd = -1;
+    if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) == static_cast<ssize_t>(sizeof(flags))) {
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+            std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    return fd;
+}
+
+// Private static function that sends a file descriptor over the given Unix domain socket, along with a byte of flags (added in version 1.3.0)
+// Returns true if successful, or false otherwise
+bool CP2130::sendFD(int socket, int fd, uint8_t flags)
+{
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    iovec iov = {&flags, sizeof(flags)};  // At least one byte of data must be sent along with the ancillary data
+    msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(socket, &message, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(flags));
+}
+
+// Private static function that converts the status of a completed URB into the value that would be returned by the corresponding libusb function (added in version 1.3.0)
+int CP2130::usbfsResult(const usbdevfs_urb *urb)
+{
+    int result;
+    if (urb->status == 0) {
+        result = urb->actual_length;
+    } else if (urb->status == -EPIPE) {
+        result = LIBUSB_ERROR_PIPE;
+    } else if (urb->status == -ENODEV || urb->status == -ESHUTDOWN) {
+        result = LIBUSB_ERROR_NO_DEVICE;
+    } else if (urb->status == -EOVERFLOW) {
+        result = LIBUSB_ERROR_OVERFLOW;
+    } else if (urb->status == -ENOENT || urb->status == -ECONNRESET) {  // The URB was discarded, which is equivalent to a cancelled libusb transfer
+        result = LIBUSB_ERROR_INTERRUPTED;
+    } else {
+        result = LIBUSB_ERROR_IO;
+    }
+    return result;
+}
+#endif
+
+// Private callback that flags the completion of a transfer submitted by streamSegment() (added in version 1.3.0)
+void LIBUSB_CALL CP2130::streamCallback(libusb_transfer *transfer)
+{
+    *static_cast<int *>(transfer->user_data) = 1;
+}
+
+// Destructor for Transport (added in version 1.3.0)
+CP2130::Transport::~Transport()
+{
+}
+
+// Returns the clock followed by the transport, which is real time by default (added in version 1.3.0)
+TimeSource &CP2130::Transport::getTimeSource()
+{
+    return TimeSource::steady();
+}
+
+// Default constructor for IdlePolicy (added in version 1.3.0)
+// By default, transfers issued after 500ms of idleness are deemed first transfers, and neither keepalives nor autosuspend changes take place
+CP2130::IdlePolicy::IdlePolicy() :
+    idle(0.5),
+    keepalive(0),
+    noautosuspend(false)
+{
+}
+
+CP2130::LatencyStats::LatencyStats() :
+    count(0),
+    min(0),
+    max(0),
+    sum(0),
+    buckets()
+{
+}
+
+// Adds a sample to LatencyStats (the value should be given in us)
+void CP2130::LatencyStats::add(double latency)
+{
+    size_t index = 0;  // Values below 1us go to the first bucket
+    if (latency >= 1) {
+        int exponent;
+        double mantissa = std::frexp(latency, &exponent);  // Note that the mantissa is in the range [0.5, 1)
+        index = 1 + LAT_SUBBUCKETS * static_cast<size_t>(exponent - 1) + static_cast<size_t>((2 * mantissa - 1) * LAT_SUBBUCKETS);
+        if (index >= LATENCY_BUCKETS) {
+            index = LATENCY_BUCKETS - 1;  // The last bucket also holds any values beyond the histogram range
+        }
+    }
+    ++buckets[index];
+    if (count == 0 || latency < min) {
+        min = latency;
+    }
+    if (count == 0 || latency > max) {
+        max = latency;
+    }
+    sum += latency;
+    ++count;
+}
+
+// Returns the mean value of LatencyStats (in us)
+double CP2130::LatencyStats::mean() const
+{
+    return count == 0 ? 0 : sum / count;
+}
+
+// Returns the given percentile of LatencyStats (in us), where "fraction" is between 0 and 1 (e.g., 0.99 corresponds to the 99th percentile)
+// The returned value is the upper bound of the corresponding bucket, so it is resolved to 12.5% (one eighth of an octave)
+double CP2130::LatencyStats::percentile(double fraction) const
+{
+    double value = 0;
+    if (count != 0) {
+        uint64_t target = static_cast<uint64_t>(std::ceil(fraction * count));
+        uint64_t accumulated = 0;
+        size_t index = 0;
+        while (index < LATENCY_BUCKETS - 1 && (accumulated += buckets[index]) < target) {
+            ++index;
+        }
+        value = index == 0 ? 1 : std::ldexp(1 + static_cast<double>((index - 1) % LAT_SUBBUCKETS + 1) / LAT_SUBBUCKETS, static_cast<int>((index - 1) / LAT_SUBBUCKETS));
+        if (value > max) {  // The value is clamped to the range of the samples
+            value = max;
+        } else if (value < min) {
+            value = min;
+        }
+    }
+    return value;
+}
+
+CP2130::OperationProfile::OperationProfile() :
+    calls(0),
+    transfers(0),
+    bytes(0),
+    cputime(),
+    walltime()
+{
+}
+
+CP2130::Profiler::Profiler() :
+    enabled_(false),
+    mutex_(),
+    profiles_()
+{
+}
+
+// Returns the profiles gathered since profiling was enabled, or since reset() was last called, keyed by operation name
+std::map<std::string, CP2130::OperationProfile> CP2130::Profiler::getProfiles() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return profiles_;
+}
+
+// Checks if profiling is enabled
+bool CP2130::Profiler::isEnabled() const
+{
+    return enabled_;
+}
+
+// Discards all profiles
+void CP2130::Profiler::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    profiles_.clear();
+}
+
+// Enables or disables profiling (profiles are kept when profiling is disabled)
+void CP2130::Profiler::setEnabled(bool enabled)
+{
+    enabled_ = enabled;
+}
+
+// The operation is only measured if profiling is enabled, and if no other operation of the same profiler is being measured on the calling thread
+// Transfers and bytes only account for the transfers issued to the given device by the calling thread, so that neither the keepalive thread nor any other thread sharing the device are charged to the operation
+CP2130::Profiler::Scope::Scope(Profiler &profiler, const CP2130 &device, const char *name) :
+    profiler_(profiler),
+    clock_(device.getTimeSource()),
+    name_(name),
+    outer_(currentProfiler),
+    outerDevice_(profiledDevice),
+    active_(profiler.enabled_ && currentProfiler != &profiler),
+    cputime_(0),
+    start_(),
+    transfers_(0),
+    bytes_(0)
+{
+    if (active_) {
+        currentProfiler = &profiler;
+        profiledDevice = &device;
+        transfers_ = profiledTransfers;
+        bytes_ = profiledBytes;
+        start_ = clock_.now();
+        cputime_ = threadCPUTime();  // Taken last, so that the setup above is not accounted for
+    }
+}
+
+// Records the operation into the profile that corresponds to its name
+CP2130::Profiler::Scope::~Scope()
+{
+    if (active_) {
+        double cputime = threadCPUTime() - cputime_;  // Taken first, for the same reason
+        double walltime = std::chrono::duration<double, std::micro>(clock_.now() - start_).count();
+        uint64_t transfers = profiledTransfers - transfers_;
+        uint64_t bytes = profiledBytes - bytes_;
+        currentProfiler = outer_;
+        profiledDevice = outerDevice_;  // The outer operation may belong to another profiler
+        std::lock_guard<std::mutex> lock(profiler_.mutex_);
+        OperationProfile &profile = profiler_.profiles_[name_];
+        ++profile.calls;
+        profile.transfers += transfers;
+        profile.bytes += bytes;
+        profile.cputime.add(cputime);
+        profile.walltime.add(walltime);
+    }
+}
+
+CP2130::TransferStats::TransferStats() :
+    ctrltrfs(0),
+    bulktrfs(0),
+    bytesin(0),
+    bytesout(0),
+    errors(0),
+    allocs(0),
+    devallocs(0),
+    coalesced(0),
+    keepalives(0),
+    ctrllat(),
+    bulklat(),
+    firstlat(),
+    steadylat(),
+    evttlm()
+{
+}
+
+// Default constructor for WatchdogPolicy (added in version 1.3.0)
+// By default, the watchdog is disabled, and it trips after three consecutive transfers taking over six standard deviations above the baseline, or once one in ten transfers fails
+CP2130::WatchdogPolicy::WatchdogPolicy() :
+    enabled(false),
+    alpha(0.02),
+    threshold(6),
+    floor(3),
+    warmup(50),
+    consecutive(3),
+    maxerrrate(0.1),
+    recover(false),
+    cooldown(10)
+{
+}
+
+// Default constructor for WatchdogStatus (added in version 1.3.0)
+CP2130::WatchdogStatus::WatchdogStatus() :
+    tripped(false),
+    samples(0),
+    anomalies(0),
+    trips(0),
+    recoveries(0),
+    baseline(1),
+    deviation(0),
+    errrate(0)
+{
+}
+
 // "Equal to" operator for EventCounter
 bool CP2130::EventCounter::operator ==(const CP2130::EventCounter &other) const
 {
@@ -199,8 +1072,54 @@ bool CP2130::USBConfig::operator !=(const CP2130::USBConfig &other) const
 CP2130::CP2130() :
     context_(nullptr),
     handle_(nullptr),
+    backend_(BACKEND_LIBUSB),
+    fd_(-1),
+    transport_(nullptr),
+    clock_(&TimeSource::steady()),
     disconnected_(false),
-    kernelWasAttached_(false)
+    kernelWasAttached_(false),
+    gpioBatching_(false),
+    gpioPendingValues_(0x0000),
+    gpioPendingMask_(0x0000),
+    wcChannels_(0x0000),
+    csSelected_(0xff),
+    wcEndpoint_(0x00),
+    wcPending_(),
+    buffer_(),
+    devmem_(nullptr),
+    devmemSize_(0),
+    stats_(),
+    evttlm_(),
+    evtLastValue_(0),
+    evtStart_(),
+    evtLastPoll_(),
+    timing_({TM_CTRLTIME, TM_BULKTIME, TM_BYTETIME}),
+    fitCount_(0),
+    fitBytes_(0),
+    fitTime_(0),
+    fitBytesTime_(0),
+    fitBytesSquared_(0),
+    trfBatching_(false),
+    urbs_(nullptr),
+    urbBuffers_(),
+    urbsPending_(0),
+    wdpolicy_(),
+    wdstatus_(),
+    wdVariance_(0),
+    wdConsecutive_(0),
+    cancelRequested_(false),
+    streamMutex_(),
+    streamTransfer_(nullptr),
+    streamURB_(nullptr),
+    profiler_(),
+    idlepolicy_(),
+    lastActivity_(),
+    inKeepalive_(false),
+    ioMutex_(),
+    kaMutex_(),
+    kaCond_(),
+    kaQuit_(false),
+    kaThread_()
 {
 }
 
@@ -215,37 +1134,137 @@ bool CP2130::disconnected() const
     return disconnected_;  // Returns true if the device has been disconnected, or false otherwise
 }
 
+// Checks if USB autosuspend is enabled for the device, as per its "power/control" attribute in sysfs (added in version 1.3.0)
+bool CP2130::isAutosuspendEnabled(int &errcnt, std::string &errstr) const
+{
+    bool enabled = false;
+#ifdef __linux__
+    std::string path = sysfsPath();
+    if (path.empty()) {
+        ++errcnt;
+        errstr += "In isAutosuspendEnabled(): device is not open, or it was opened via a transport.\n";  // Program logic error
+    } else {
+        path += "/power/control";
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        char value[8] = {};
+        if (fd == -1 || ::read(fd, value, sizeof(value) - 1) < 2) {
+            ++errcnt;
+            errstr += "Could not read \"" + path + "\".\n";
+        } else {
+            enabled = std::strncmp(value, "auto", 4) == 0;  // The attribute reads "auto" if autosuspend is enabled, or "on" otherwise
+        }
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+#else
+    ++errcnt;
+    errstr += "In isAutosuspendEnabled(): autosuspend control is only supported on Linux.\n";  // Program logic error
+#endif
+    return enabled;
+}
+
 // Checks if the device is open
 bool CP2130::isOpen() const
 {
-    return handle_ != nullptr;  // Returns true if the device is open, or false otherwise
+    return handle_ != nullptr || fd_ != -1 || transport_ != nullptr;  // Returns true if the device is open, or false otherwise (the usbfs and transport backends were added in version 1.3.0)
+}
+
+// Checks if profiling is enabled (added in version 1.3.0)
+bool CP2130::isProfiling() const
+{
+    return profiler_.isEnabled();
+}
+
+// Checks if write coalescing is enabled for the given channel (added in version 1.3.0)
+bool CP2130::isWriteCoalescing(uint8_t channel) const
+{
+    return channel <= 10 && (0x0001 << channel & wcChannels_) != 0x0000;
+}
+
+// Starts combining GPIO writes (added in version 1.3.0)
+// From this point on, consecutive calls to setGPIOs() (or to any of the setGPIO functions) are merged into a single Set_GPIO_Values transfer, as long as they target different pins
+// A write to a pin that already has a pending write, as well as any other transfer, causes the pending writes to be sent first, so that the order of the edges on each pin is preserved
+void CP2130::beginGPIOBatch()
+{
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    gpioBatching_ = true;
+}
+
+// Starts a transfer batch (added in version 1.3.0)
+// When using the usbfs backend, host-to-device control transfers are then submitted without waiting for them to complete, and are queued by the host controller, which carries them out in order
+// Pending transfers are reaped, and their errors reported, before any other transfer, and also by flushTransfers() or endTransferBatch()
+// Chip select changes are always carried out synchronously, since the calling algorithm may need to wait for these to settle
+// With the libusb backend, transfer batches have no effect
+void CP2130::beginTransferBatch()
+{
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    trfBatching_ = true;
 }
 
 // Safe bulk transfer
 void CP2130::bulkTransfer(uint8_t endpointAddr, unsigned char *data, int length, int *transferred, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    if (!wcPending_.empty()) {  // Any pending SPI writes must be sent before this transfer (since version 1.3.0)
+        flushWrites(errcnt, errstr);
+    }
+    if (gpioPendingMask_ != 0x0000) {  // Any pending GPIO writes must be sent before this transfer (since version 1.3.0)
+        flushGPIOs(errcnt, errstr);
+    }
+    if (urbsPending_ != 0) {  // As well as any pending transfers (since version 1.3.0)
+        flushTransfers(errcnt, errstr);
+    }
     if (!isOpen()) {
         ++errcnt;
         errstr += "In bulkTransfer(): device is not open.\n";  // Program logic error
     } else {
-        int result = libusb_bulk_transfer(handle_, endpointAddr, data, length, transferred, TR_TIMEOUT);
+        int bytesTransferred = 0;
+        std::chrono::steady_clock::time_point start = clock_->now();  // The clock of the device is used, which may be virtual if the device is simulated (since version 1.3.0)
+        int result;
+        if (backend_ == BACKEND_USBFS) {  // The usbfs backend was implemented in version 1.3.0
+#ifdef __linux__
+            result = usbfsBulkTransfer(endpointAddr, data, length, &bytesTransferred);
+#else
+            result = LIBUSB_ERROR_NOT_SUPPORTED;  // Not reached, since the usbfs backend cannot be selected elsewhere
+#endif
+        } else if (backend_ == BACKEND_TRANSPORT) {  // As well as the transport backend
+            result = transport_->bulkTransfer(endpointAddr, data, length, &bytesTransferred);
+        } else {
+            result = libusb_bulk_transfer(handle_, endpointAddr, data, length, &bytesTransferred, TR_TIMEOUT);
+        }
+        lastActivity_ = clock_->now();
+        double latency = std::chrono::duration<double, std::micro>(lastActivity_ - start).count();
+        stats_.bulklat.add(latency);  // Transfer statistics were implemented in version 1.3.0
+        ++stats_.bulktrfs;
+        watchdogSample(latency, timing_.bulktime + timing_.bytetime * length, result != 0 || (transferred != nullptr && bytesTransferred != length));  // Feed the watchdog (since version 1.3.0)
+        if (result == 0) {  // Successful bulk transfers are used to calibrate the timing model, by fitting their durations to their lengths
+            fitCount_ += 1;
+            fitBytes_ += length;
+            fitTime_ += latency;
+            fitBytesTime_ += static_cast<double>(length) * latency;
+            fitBytesSquared_ += static_cast<double>(length) * length;
+        }
+        if (endpointAddr < 0x80) {
+            stats_.bytesout += static_cast<uint64_t>(bytesTransferred);
+        } else {
+            stats_.bytesin += static_cast<uint64_t>(bytesTransferred);
+        }
+        profileTransfer(static_cast<uint64_t>(bytesTransferred));
+        if (transferred != nullptr) {
+            *transferred = bytesTransferred;
+        }
         if (result != 0 || (transferred != nullptr && *transferred != length)) {  // The number of transferred bytes is also verified, as long as a valid (non-null) pointer is passed via "transferred"
             ++errcnt;
-            std::ostringstream stream;
+            ++stats_.errors;
+            char message[MSG_BUFFER_SIZE];
             if (endpointAddr < 0x80) {
-                stream << "Failed bulk OUT transfer to endpoint "
-                       << (0x0f & endpointAddr)
-                       << " (address 0x"
-                       << std::hex << std::setfill ('0') << std::setw(2) << static_cast<int>(endpointAddr)
-                       << ")." << std::endl;
+                std::snprintf(message, sizeof(message), "Failed bulk OUT transfer to endpoint %u (address 0x%02x).\n", 0x0f & endpointAddr, endpointAddr);
             } else {
-                stream << "Failed bulk IN transfer from endpoint "
-                       << (0x0f & endpointAddr)
-                       << " (address 0x"
-                       << std::hex << std::setfill ('0') << std::setw(2) << static_cast<int>(endpointAddr)
-                       << ")." << std::endl;
+                std::snprintf(message, sizeof(message), "Failed bulk IN transfer from endpoint %u (address 0x%02x).\n", 0x0f & endpointAddr, endpointAddr);
             }
-            errstr += stream.str();
+            errstr += message;
             if (result == LIBUSB_ERROR_NO_DEVICE || result == LIBUSB_ERROR_IO) {  // Note that libusb_bulk_transfer() may return "LIBUSB_ERROR_IO" [-1] on device disconnect
                 disconnected_ = true;  // This reports that the device has been disconnected
             }
@@ -253,17 +1272,74 @@ void CP2130::bulkTransfer(uint8_t endpointAddr, unsigned char *data, int length,
     }
 }
 
+// Calibrates the timing model against the transfer durations measured since the transfer statistics were last reset (added in version 1.3.0)
+// The duration of control transfers is set to the measured mean, while the duration of bulk transfers is fitted to their lengths by least squares
+void CP2130::calibrateTimingModel()
+{
+    if (stats_.ctrllat.count != 0) {
+        timing_.ctrltime = stats_.ctrllat.mean();
+    }
+    if (fitCount_ != 0) {
+        double denominator = fitCount_ * fitBytesSquared_ - fitBytes_ * fitBytes_;
+        if (denominator > 0) {  // The duration per byte can only be fitted if transfers of at least two different lengths were measured
+            double bytetime = (fitCount_ * fitBytesTime_ - fitBytes_ * fitTime_) / denominator;
+            if (bytetime >= 0) {
+                timing_.bytetime = bytetime;
+            }
+        }
+        double bulktime = (fitTime_ - timing_.bytetime * fitBytes_) / fitCount_;
+        timing_.bulktime = bulktime < 0 ? 0 : bulktime;
+    }
+}
+
+// Requests the cancellation of the stream in progress, if any (added in version 1.3.0)
+// This function is meant to be called from another thread, and it cancels the transfer in flight as well, if the libusb or usbfs backends are in use. See spiWriteStream() and spiWriteReadStream() for details
+void CP2130::cancel()
+{
+    std::lock_guard<std::mutex> guard(streamMutex_);
+    cancelRequested_ = true;
+    if (streamTransfer_ != nullptr) {
+        libusb_cancel_transfer(streamTransfer_);
+#ifdef __linux__
+    } else if (streamURB_ != nullptr) {
+        ioctl(fd_, USBDEVFS_DISCARDURB, streamURB_);
+#endif
+    }
+}
+
 // Closes the device safely, if open
 void CP2130::close()
 {
+    stopKeepalive();  // The keepalive thread must not outlive the device (since version 1.3.0)
     if (isOpen()) {  // This condition avoids a segmentation fault if the calling algorithm tries, for some reason, to close the same device twice (e.g., if the device is already closed when the destructor is called)
-        libusb_release_interface(handle_, 0);  // Release the interface
-        if (kernelWasAttached_) {  // If a kernel driver was attached to the interface before
-            libusb_attach_kernel_driver(handle_, 0);  // Reattach the kernel driver
+        int errcnt = 0;
+        std::string errstr;
+        endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes (errors are ignored, as the device is being closed anyway)
+        flushWrites(errcnt, errstr);  // Send any pending SPI writes (since version 1.3.0)
+        endTransferBatch(errcnt, errstr);  // Reap any pending transfers (since version 1.3.0)
+        csSelected_ = 0xff;
+        releaseBuffer();  // Free any device memory, while the device is still open (since version 1.3.0)
+        if (backend_ == BACKEND_USBFS) {
+#ifdef __linux__
+            usbfsClose(true);  // Release the interface and close the device node
+#endif
+        } else if (backend_ == BACKEND_TRANSPORT) {
+            transport_ = nullptr;  // The transport is not owned by this object (since version 1.3.0)
+            clock_ = &TimeSource::steady();  // Neither is its clock
+        } else {
+            libusb_release_interface(handle_, 0);  // Release the interface
+            if (kernelWasAttached_) {  // If a kernel driver was attached to the interface before
+                libusb_attach_kernel_driver(handle_, 0);  // Reattach the kernel driver
+            }
+            libusb_close(handle_);  // Close the device
+            libusb_exit(context_);  // Deinitialize libusb
+            handle_ = nullptr;  // Required to mark the device as closed
+            if (fd_ != -1) {  // If the device was opened via openFD(), the file descriptor is not closed by libusb (since version 1.3.0)
+                ::close(fd_);
+                fd_ = -1;
+            }
         }
-        libusb_close(handle_);  // Close the device
-        libusb_exit(context_);  // Deinitialize libusb
-        handle_ = nullptr;  // Required to mark the device as closed
+        evttlm_.active = false;  // Event telemetry cannot go on without a device
     }
 }
 
@@ -271,6 +1347,7 @@ void CP2130::close()
 // Note that this function can override the GPIO pin modes programmed in the OTP ROM configuration
 void CP2130::configureGPIO(uint8_t pin, uint8_t mode, bool value,  int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     if (pin > 10) {
         ++errcnt;
         errstr += "In configureGPIO(): Pin number must be between 0 and 10.\n";  // Program logic error
@@ -287,6 +1364,7 @@ void CP2130::configureGPIO(uint8_t pin, uint8_t mode, bool value,  int &errcnt,
 // Configures delays for a given SPI channel
 void CP2130::configureSPIDelays(uint8_t channel, const SPIDelays &delays, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     if (channel > 10) {
         ++errcnt;
         errstr += "In configureSPIDelays(): SPI channel value must be between 0 and 10.\n";  // Program logic error
@@ -305,6 +1383,7 @@ void CP2130::configureSPIDelays(uint8_t channel, const SPIDelays &delays, int &e
 // Configures the given SPI channel in respect to its chip select mode, clock frequency, polarity and phase
 void CP2130::configureSPIMode(uint8_t channel, const SPIMode &mode, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     if (channel > 10) {
         ++errcnt;
         errstr += "In configureSPIMode(): SPI channel value must be between 0 and 10.\n";  // Program logic error
@@ -320,20 +1399,62 @@ void CP2130::configureSPIMode(uint8_t channel, const SPIMode &mode, int &errcnt,
 // Safe control transfer
 void CP2130::controlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);  // Serializes transfers with the keepalive thread (since version 1.3.0)
+    if (!wcPending_.empty()) {  // Any pending SPI writes must be sent before this transfer, including any chip select change (since version 1.3.0)
+        flushWrites(errcnt, errstr);
+    }
+    if (gpioPendingMask_ != 0x0000) {  // Any pending GPIO writes must be sent before this transfer (since version 1.3.0)
+        flushGPIOs(errcnt, errstr);
+    }
     if (!isOpen()) {
         ++errcnt;
         errstr += "In controlTransfer(): device is not open.\n";  // Program logic error
+#ifdef __linux__
+    } else if (trfBatching_ && backend_ == BACKEND_USBFS && bmRequestType == SET && bRequest != SET_GPIO_CHIP_SELECT && wLength <= URB_DATA_SIZE) {  // Within a transfer batch, host-to-device transfers are submitted without waiting (since version 1.3.0)
+        usbfsDeferControlTransfer(bmRequestType, bRequest, wValue, wIndex, data, wLength, errcnt, errstr);
+        lastActivity_ = clock_->now();
+#endif
     } else {
-        int result = libusb_control_transfer(handle_, bmRequestType, bRequest, wValue, wIndex, data, wLength, TR_TIMEOUT);
+        if (urbsPending_ != 0) {  // Any pending transfers must be reaped before this transfer (since version 1.3.0)
+            flushTransfers(errcnt, errstr);
+        }
+        std::chrono::steady_clock::time_point start = clock_->now();  // The clock of the device is used, which may be virtual if the device is simulated (since version 1.3.0)
+        int result;
+        if (backend_ == BACKEND_USBFS) {  // The usbfs backend was implemented in version 1.3.0
+#ifdef __linux__
+            result = usbfsControlTransfer(bmRequestType, bRequest, wValue, wIndex, data, wLength);
+#else
+            result = LIBUSB_ERROR_NOT_SUPPORTED;  // Not reached, since the usbfs backend cannot be selected elsewhere
+#endif
+        } else if (backend_ == BACKEND_TRANSPORT) {  // As well as the transport backend
+            result = transport_->controlTransfer(bmRequestType, bRequest, wValue, wIndex, data, wLength);
+        } else {
+            result = libusb_control_transfer(handle_, bmRequestType, bRequest, wValue, wIndex, data, wLength, TR_TIMEOUT);
+        }
+        bool first = std::chrono::duration<double>(start - lastActivity_).count() >= idlepolicy_.idle;  // The transfer is a first transfer if the device sat idle beforehand (since version 1.3.0)
+        lastActivity_ = clock_->now();
+        double latency = std::chrono::duration<double, std::micro>(lastActivity_ - start).count();
+        stats_.ctrllat.add(latency);  // Transfer statistics were implemented in version 1.3.0
+        ++stats_.ctrltrfs;
+        if (!inKeepalive_) {  // Keepalive transfers are only accounted for in "ctrllat"
+            (first ? stats_.firstlat : stats_.steadylat).add(latency);
+        }
+        watchdogSample(latency, timing_.ctrltime, result != wLength);  // Feed the watchdog (since version 1.3.0)
+        if (result > 0) {
+            if (bmRequestType == GET) {
+                stats_.bytesin += static_cast<uint64_t>(result);
+            } else {
+                stats_.bytesout += static_cast<uint64_t>(result);
+            }
+        }
+        profileTransfer(result > 0 ? static_cast<uint64_t>(result) : 0);
         if (result != wLength) {
             ++errcnt;
-            std::ostringstream stream;
-            stream << "Failed control transfer (0x"
-                   << std::hex << std::setfill ('0') << std::setw(2) << static_cast<int>(bmRequestType)
-                   << ", 0x"
-                   << std::setw(2) << static_cast<int>(bRequest)
-                   << ")." << std::endl;
-            errstr += stream.str();
+            ++stats_.errors;
+            char message[MSG_BUFFER_SIZE];
+            std::snprintf(message, sizeof(message), "Failed control transfer (0x%02x, 0x%02x).\n", bmRequestType, bRequest);
+            errstr += message;
             if (result == LIBUSB_ERROR_NO_DEVICE || result == LIBUSB_ERROR_IO || result == LIBUSB_ERROR_PIPE) {  // Note that libusb_control_transfer() may return "LIBUSB_ERROR_IO" [-1] or "LIBUSB_ERROR_PIPE" [-9] on device disconnect
                 disconnected_ = true;  // This reports that the device has been disconnected
             }
@@ -344,6 +1465,7 @@ void CP2130::controlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t w
 // Disables the chip select of the target channel
 void CP2130::disableCS(uint8_t channel, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     if (channel > 10) {
         ++errcnt;
         errstr += "In disableCS(): SPI channel value must be between 0 and 10.\n";  // Program logic error
@@ -353,45 +1475,177 @@ void CP2130::disableCS(uint8_t channel, int &errcnt, std::string &errstr)
             0x00      // Corresponding chip select disabled
         };
         controlTransfer(SET, SET_GPIO_CHIP_SELECT, 0x0000, 0x0000, controlBufferOut, SET_GPIO_CHIP_SELECT_WLEN, errcnt, errstr);
+        csSelected_ = 0xff;  // No single chip select is known to be enabled, from this point onwards (since version 1.3.0)
+    }
+}
+
+// Disables all SPI delays for a given channel
+void CP2130::disableSPIDelays(uint8_t channel, int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    if (channel > 10) {
+        ++errcnt;
+        errstr += "In disableSPIDelays(): SPI channel value must be between 0 and 10.\n";  // Program logic error
+    } else {
+        unsigned char controlBufferOut[SET_SPI_DELAY_WLEN] = {
+            channel,     // Selected channel
+            0x00,        // All SPI delays disabled, no CS toggle
+            0x00, 0x00,  // Inter-byte,
+            0x00, 0x00,  // post-assert and
+            0x00, 0x00   // pre-deassert delays all set to 0us
+        };
+        controlTransfer(SET, SET_SPI_DELAY, 0x0000, 0x0000, controlBufferOut, SET_SPI_DELAY_WLEN, errcnt, errstr);
     }
 }
 
-// Disables all SPI delays for a given channel
-void CP2130::disableSPIDelays(uint8_t channel, int &errcnt, std::string &errstr)
+// Enables the chip select of the target channel
+void CP2130::enableCS(uint8_t channel, int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    if (channel > 10) {
+        ++errcnt;
+        errstr += "In enableCS(): SPI channel value must be between 0 and 10.\n";  // Program logic error
+    } else {
+        unsigned char controlBufferOut[SET_GPIO_CHIP_SELECT_WLEN] = {
+            channel,  // Selected channel
+            0x01      // Corresponding chip select enabled
+        };
+        controlTransfer(SET, SET_GPIO_CHIP_SELECT, 0x0000, 0x0000, controlBufferOut, SET_GPIO_CHIP_SELECT_WLEN, errcnt, errstr);
+        csSelected_ = 0xff;  // Other chip selects may be enabled as well, so writes are not coalesced (since version 1.3.0)
+    }
+}
+
+// Sends any pending GPIO writes and stops combining them (added in version 1.3.0)
+void CP2130::endGPIOBatch(int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    flushGPIOs(errcnt, errstr);
+    gpioBatching_ = false;
+}
+
+// Reaps any pending transfers and ends the transfer batch (added in version 1.3.0)
+void CP2130::endTransferBatch(int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    flushTransfers(errcnt, errstr);
+    trfBatching_ = false;
+}
+
+// Sends any pending GPIO writes as a single Set_GPIO_Values transfer (added in version 1.3.0)
+void CP2130::flushGPIOs(int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    if (gpioPendingMask_ != 0x0000) {
+        unsigned char controlBufferOut[SET_GPIO_VALUES_WLEN] = {
+            static_cast<uint8_t>(gpioPendingValues_ >> 8), static_cast<uint8_t>(gpioPendingValues_),  // GPIO values bitmap
+            static_cast<uint8_t>(gpioPendingMask_ >> 8), static_cast<uint8_t>(gpioPendingMask_)       // Mask bitmap
+        };
+        gpioPendingValues_ = 0x0000;  // The pending writes must be cleared before calling controlTransfer(), since the latter flushes them
+        gpioPendingMask_ = 0x0000;
+        controlTransfer(SET, SET_GPIO_VALUES, 0x0000, 0x0000, controlBufferOut, SET_GPIO_VALUES_WLEN, errcnt, errstr);
+    }
+}
+
+// Sends any pending SPI writes, merged into a single Write command (added in version 1.3.0)
+// This acts as a barrier for write coalescing, and it is called implicitly before any other transfer
+void CP2130::flushWrites(int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    if (!wcPending_.empty()) {
+        std::vector<uint8_t> data;
+        data.swap(wcPending_);  // The pending writes must be cleared before calling writeCommand(), since bulkTransfer() flushes them
+        writeCommand(data.data(), data.size(), wcEndpoint_, errcnt, errstr);
+        data.clear();
+        data.swap(wcPending_);  // Keep the capacity for the next writes
+    }
+}
+
+// Waits for every pending transfer to complete, reporting any errors (added in version 1.3.0)
+// Transfers that are still pending when the transfer timeout expires are discarded
+void CP2130::flushTransfers(int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+#ifdef __linux__  // Elsewhere, no transfers are ever pending, since only the usbfs backend defers them
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TR_TIMEOUT);
+    while (urbsPending_ != 0) {
+        int result;
+        usbdevfs_urb *urb = usbfsReap(deadline, result);
+        if (urb == nullptr) {  // If no URB could be reaped, every pending URB is discarded and reaped
+            for (size_t i = 0; i < urbsPending_; ++i) {
+                ioctl(fd_, USBDEVFS_DISCARDURB, &urbs_[i]);
+            }
+            for (size_t i = 0; i < urbsPending_; ++i) {
+                void *discarded = nullptr;
+                ioctl(fd_, USBDEVFS_REAPURB, &discarded);
+            }
+        } else {
+            result = usbfsResult(urb);
+        }
+        size_t failed = urb == nullptr ? urbsPending_ : 1;
+        if (urb == nullptr || result != urb->buffer_length - static_cast<int>(URB_SETUP_SIZE)) {
+            unsigned char *setup = static_cast<unsigned char *>((urb == nullptr ? &urbs_[0] : urb)->buffer);
+            errcnt += static_cast<int>(failed);
+            stats_.errors += failed;
+            char message[MSG_BUFFER_SIZE];
+            std::snprintf(message, sizeof(message), "Failed control transfer (0x%02x, 0x%02x).\n", setup[0], setup[1]);
+            errstr += message;
+            if (result == LIBUSB_ERROR_NO_DEVICE || result == LIBUSB_ERROR_IO || result == LIBUSB_ERROR_PIPE) {
+                disconnected_ = true;  // This reports that the device has been disconnected
+            }
+        }
+        urbsPending_ -= failed;
+    }
+#else
+    (void)errcnt;
+    (void)errstr;
+#endif
+}
+
+// Returns the expected duration of a control transfer (in us), according to the timing model (added in version 1.3.0)
+double CP2130::estimateControlTime() const
+{
+    return timing_.ctrltime;
+}
+
+// Returns the expected duration (in us) of spiRead(), when reading the given number of bytes at the given SPI clock frequency (added in version 1.3.0)
+// This includes both bulk transfers, as well as the time taken to clock the data in
+double CP2130::estimateSPIReadTime(uint32_t bytes, uint8_t cfrq) const
 {
-    if (channel > 10) {
-        ++errcnt;
-        errstr += "In disableSPIDelays(): SPI channel value must be between 0 and 10.\n";  // Program logic error
-    } else {
-        unsigned char controlBufferOut[SET_SPI_DELAY_WLEN] = {
-            channel,     // Selected channel
-            0x00,        // All SPI delays disabled, no CS toggle
-            0x00, 0x00,  // Inter-byte,
-            0x00, 0x00,  // post-assert and
-            0x00, 0x00   // pre-deassert delays all set to 0us
-        };
-        controlTransfer(SET, SET_SPI_DELAY, 0x0000, 0x0000, controlBufferOut, SET_SPI_DELAY_WLEN, errcnt, errstr);
-    }
+    return 2 * timing_.bulktime + (bytes + 8) * timing_.bytetime + 8 * bytes * 1000000 / spiClockFrequency(cfrq);
 }
 
-// Enables the chip select of the target channel
-void CP2130::enableCS(uint8_t channel, int &errcnt, std::string &errstr)
+// Returns the expected duration (in us) of spiWrite(), when writing the given number of bytes at the given SPI clock frequency and using the given SPI delays (added in version 1.3.0)
+// This includes the bulk transfer, as well as the time taken to clock the data out, which is when the SPI bus is released
+double CP2130::estimateSPIWriteTime(uint32_t bytes, uint8_t cfrq, const SPIDelays &delays) const
 {
-    if (channel > 10) {
-        ++errcnt;
-        errstr += "In enableCS(): SPI channel value must be between 0 and 10.\n";  // Program logic error
-    } else {
-        unsigned char controlBufferOut[SET_GPIO_CHIP_SELECT_WLEN] = {
-            channel,  // Selected channel
-            0x01      // Corresponding chip select enabled
-        };
-        controlTransfer(SET, SET_GPIO_CHIP_SELECT, 0x0000, 0x0000, controlBufferOut, SET_GPIO_CHIP_SELECT_WLEN, errcnt, errstr);
+    double duration = timing_.bulktime + (bytes + 8) * timing_.bytetime + 8 * bytes * 1000000 / spiClockFrequency(cfrq);
+    if (delays.itbyten && bytes > 1) {
+        duration += 10.0 * delays.itbytdly * (bytes - 1);  // Inter-byte delays are given in 10us units
+    }
+    if (delays.pstasten) {
+        duration += 10.0 * delays.pstastdly;
     }
+    if (delays.prdasten) {
+        duration += 10.0 * delays.prdastdly;
+    }
+    return duration;
+}
+
+// This function is a shorthand version of the previous one, assuming that all SPI delays are disabled
+double CP2130::estimateSPIWriteTime(uint32_t bytes, uint8_t cfrq) const
+{
+    return estimateSPIWriteTime(bytes, cfrq, {false, false, false, false, 0x0000, 0x0000, 0x0000});
 }
 
 // Returns the current clock divider value
 uint8_t CP2130::getClockDivider(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferIn[GET_CLOCK_DIVIDER_WLEN];
     controlTransfer(GET, GET_CLOCK_DIVIDER, 0x0000, 0x0000, controlBufferIn, GET_CLOCK_DIVIDER_WLEN, errcnt, errstr);
     return controlBufferIn[0];
@@ -400,6 +1654,7 @@ uint8_t CP2130::getClockDivider(int &errcnt, std::string &errstr)
 // Returns the chip select status for a given channel
 bool CP2130::getCS(uint8_t channel, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     bool cs;
     if (channel > 10) {
         ++errcnt;
@@ -416,18 +1671,27 @@ bool CP2130::getCS(uint8_t channel, int &errcnt, std::string &errstr)
 // Returns the address of the endpoint assuming the IN direction
 uint8_t CP2130::getEndpointInAddr(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return getTransferPriority(errcnt, errstr) == PRIOWRITE ? 0x82 : 0x81;
 }
 
 // Returns the address of the endpoint assuming the OUT direction
 uint8_t CP2130::getEndpointOutAddr(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return getTransferPriority(errcnt, errstr) == PRIOWRITE ? 0x01 : 0x02;
 }
 
+// Returns the backend in use (added in version 1.3.0)
+uint8_t CP2130::getBackend() const
+{
+    return backend_;
+}
+
 // Gets the event counter, including mode and value
 CP2130::EventCounter CP2130::getEventCounter(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferIn[GET_EVENT_COUNTER_WLEN];
     controlTransfer(GET, GET_EVENT_COUNTER, 0x0000, 0x0000, controlBufferIn, GET_EVENT_COUNTER_WLEN, errcnt, errstr);
     CP2130::EventCounter evtcntr;
@@ -437,9 +1701,22 @@ CP2130::EventCounter CP2130::getEventCounter(int &errcnt, std::string &errstr)
     return evtcntr;
 }
 
+// Returns the event counter telemetry, as of the last poll (added in version 1.3.0)
+CP2130::EventTelemetry CP2130::getEventTelemetry() const
+{
+    return evttlm_;
+}
+
+// Returns the idle policy (added in version 1.3.0)
+CP2130::IdlePolicy CP2130::getIdlePolicy() const
+{
+    return idlepolicy_;
+}
+
 // Gets the full FIFO threshold
 uint8_t CP2130::getFIFOThreshold(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferIn[GET_FULL_THRESHOLD_WLEN];
     controlTransfer(GET, GET_FULL_THRESHOLD, 0x0000, 0x0000, controlBufferIn, GET_FULL_THRESHOLD_WLEN, errcnt, errstr);
     return controlBufferIn[0];
@@ -448,72 +1725,84 @@ uint8_t CP2130::getFIFOThreshold(int &errcnt, std::string &errstr)
 // Returns the current value of the GPIO.0 pin on the CP2130
 bool CP2130::getGPIO0(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO0 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.1 pin on the CP2130
 bool CP2130::getGPIO1(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO1 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.2 pin on the CP2130
 bool CP2130::getGPIO2(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO2 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.3 pin on the CP2130
 bool CP2130::getGPIO3(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO3 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.4 pin on the CP2130
 bool CP2130::getGPIO4(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO4 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.5 pin on the CP2130
 bool CP2130::getGPIO5(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO5 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.6 pin on the CP2130
 bool CP2130::getGPIO6(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO6 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.7 pin on the CP2130
 bool CP2130::getGPIO7(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO7 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.8 pin on the CP2130
 bool CP2130::getGPIO8(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO8 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.9 pin on the CP2130
 bool CP2130::getGPIO9(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO9 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the current value of the GPIO.10 pin on the CP2130
 bool CP2130::getGPIO10(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (BMGPIO10 & getGPIOs(errcnt, errstr)) != 0x0000;
 }
 
 // Returns the value of all GPIO pins on the CP2130, in bitmap format
 uint16_t CP2130::getGPIOs(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferIn[GET_GPIO_VALUES_WLEN];
     controlTransfer(GET, GET_GPIO_VALUES, 0x0000, 0x0000, controlBufferIn, GET_GPIO_VALUES_WLEN, errcnt, errstr);
     return static_cast<uint16_t>(BMGPIOS & (controlBufferIn[0] << 8 | controlBufferIn[1]));  // Returns the value of every GPIO pin in bitmap format (big-endian conversion)
@@ -522,6 +1811,7 @@ uint16_t CP2130::getGPIOs(int &errcnt, std::string &errstr)
 // Returns the lock word from the CP2130 OTP ROM
 uint16_t CP2130::getLockWord(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferIn[GET_LOCK_BYTE_WLEN];
     controlTransfer(GET, GET_LOCK_BYTE, 0x0000, 0x0000, controlBufferIn, GET_LOCK_BYTE_WLEN, errcnt, errstr);
     return static_cast<uint16_t>(controlBufferIn[1] << 8 | controlBufferIn[0]);  // Returns both lock bytes as a word (little-endian conversion)
@@ -530,12 +1820,20 @@ uint16_t CP2130::getLockWord(int &errcnt, std::string &errstr)
 // Gets the manufacturer descriptor from the CP2130 OTP ROM
 std::u16string CP2130::getManufacturerDesc(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return getDescGeneric(GET_MANUFACTURING_STRING_1, errcnt, errstr);
 }
 
+// Returns the operation profiles gathered while profiling was enabled, keyed by function name (added in version 1.3.0)
+std::map<std::string, CP2130::OperationProfile> CP2130::getOperationProfiles() const
+{
+    return profiler_.getProfiles();
+}
+
 // Gets the pin configuration from the CP2130 OTP ROM
 CP2130::PinConfig CP2130::getPinConfig(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferIn[GET_PIN_CONFIG_WLEN];
     controlTransfer(GET, GET_PIN_CONFIG, 0x0000, 0x0000, controlBufferIn, GET_PIN_CONFIG_WLEN, errcnt, errstr);
     PinConfig config;
@@ -561,12 +1859,14 @@ CP2130::PinConfig CP2130::getPinConfig(int &errcnt, std::string &errstr)
 // Gets the product descriptor from the CP2130 OTP ROM
 std::u16string CP2130::getProductDesc(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return getDescGeneric(GET_PRODUCT_STRING_1, errcnt, errstr);
 }
 
 // Gets the entire CP2130 OTP ROM content as a structure of eight 64-byte blocks
 CP2130::PROMConfig CP2130::getPROMConfig(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     PROMConfig config;
     for (size_t i = 0; i < PROM_BLOCKS; ++i) {
         unsigned char controlBufferIn[GET_PROM_CONFIG_WLEN];
@@ -581,12 +1881,14 @@ CP2130::PROMConfig CP2130::getPROMConfig(int &errcnt, std::string &errstr)
 // Gets the serial descriptor from the CP2130 OTP ROM
 std::u16string CP2130::getSerialDesc(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return getDescGeneric(GET_SERIAL_STRING, errcnt, errstr);
 }
 
 // Returns the CP2130 silicon, read-only version
 CP2130::SiliconVersion CP2130::getSiliconVersion(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferIn[GET_READONLY_VERSION_WLEN];
     controlTransfer(GET, GET_READONLY_VERSION, 0x0000, 0x0000, controlBufferIn, GET_READONLY_VERSION_WLEN, errcnt, errstr);
     SiliconVersion version;
@@ -598,6 +1900,7 @@ CP2130::SiliconVersion CP2130::getSiliconVersion(int &errcnt, std::string &errst
 // Returns the SPI delays for a given channel
 CP2130::SPIDelays CP2130::getSPIDelays(uint8_t channel, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     SPIDelays delays;
     if (channel > 10) {
         ++errcnt;
@@ -620,6 +1923,7 @@ CP2130::SPIDelays CP2130::getSPIDelays(uint8_t channel, int &errcnt, std::string
 // Returns the SPI mode for a given channel
 CP2130::SPIMode CP2130::getSPIMode(uint8_t channel, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     SPIMode mode;
     if (channel > 10) {
         ++errcnt;
@@ -636,15 +1940,39 @@ CP2130::SPIMode CP2130::getSPIMode(uint8_t channel, int &errcnt, std::string &er
     return mode;
 }
 
+// Returns the clock followed by the device, which is real time unless the device was opened via a transport that follows another clock (added in version 1.3.0)
+// Virtual time is thus confined to simulated devices (see TimeSource), while real devices, along with their workaround delays, keep following real time
+TimeSource &CP2130::getTimeSource() const
+{
+    return *clock_;
+}
+
+// Returns the timing model (added in version 1.3.0)
+CP2130::TimingModel CP2130::getTimingModel() const
+{
+    return timing_;
+}
+
 // Returns the transfer priority from the CP2130 OTP ROM
 uint8_t CP2130::getTransferPriority(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return getUSBConfig(errcnt, errstr).trfprio;  // Refactored in version 1.1.0, because the overhead presented by this solution was found to be very slim
 }
 
+// Returns the transfer statistics gathered since the object was created, or since resetTransferStats() was last called (added in version 1.3.0)
+CP2130::TransferStats CP2130::getTransferStats() const
+{
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);  // The keepalive thread may update the statistics concurrently
+    TransferStats stats = stats_;
+    stats.evttlm = evttlm_;  // Event counter telemetry is published alongside
+    return stats;
+}
+
 // Gets the USB configuration, including VID, PID, major and minor release versions, from the CP2130 OTP ROM
 CP2130::USBConfig CP2130::getUSBConfig(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferIn[GET_USB_CONFIG_WLEN];
     controlTransfer(GET, GET_USB_CONFIG, 0x0000, 0x0000, controlBufferIn, GET_USB_CONFIG_WLEN, errcnt, errstr);
     USBConfig config;
@@ -658,21 +1986,98 @@ CP2130::USBConfig CP2130::getUSBConfig(int &errcnt, std::string &errstr)
     return config;
 }
 
+// Returns the watchdog policy (added in version 1.3.0)
+CP2130::WatchdogPolicy CP2130::getWatchdogPolicy() const
+{
+    return wdpolicy_;
+}
+
+// Returns the watchdog status, including its rolling baselines (added in version 1.3.0)
+CP2130::WatchdogStatus CP2130::getWatchdogStatus() const
+{
+    return wdstatus_;
+}
+
+// Hands the device off to another process, by passing the file descriptor of its usbfs device node over the given Unix domain socket (added in version 1.3.0)
+// This is specific to Linux. The receiving process should call takeOver(). Once the device is handed off, it is closed here, but its interface stays claimed and the kernel driver stays detached, so that the device is neither re-enumerated nor reset, and its outputs are not disturbed
+void CP2130::handOff(int socket, int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    if (!isOpen()) {
+        ++errcnt;
+        errstr += "In handOff(): device is not open.\n";  // Program logic error
+    } else if (backend_ == BACKEND_TRANSPORT) {
+        ++errcnt;
+        errstr += "In handOff(): device was opened via a transport, and cannot be handed off.\n";  // Program logic error
+    } else {
+#ifdef __linux__
+        stopKeepalive();  // No keepalive may take place while the device changes hands
+        endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes, and reap any pending transfers, so that nothing is left behind
+        flushWrites(errcnt, errstr);
+        endTransferBatch(errcnt, errstr);
+        releaseBuffer();  // Device memory is tied to this process, and it is reallocated if the device stays open
+        uint8_t flags = kernelWasAttached_ ? HOFLAG_KERNEL : 0x00;  // The receiving process becomes responsible for reattaching the kernel driver
+        if (fd_ != -1) {  // The device was opened via usbfs or via openFD(), so its file descriptor is passed as is, and the interface remains claimed through it
+            if (!sendFD(socket, fd_, flags)) {
+                ++errcnt;
+                errstr += "Failed to hand off the device.\n";
+            } else if (backend_ == BACKEND_USBFS) {
+                usbfsClose(false);  // Close the device node, without releasing the interface
+            } else {
+                libusb_close(handle_);  // libusb does not close file descriptors that it did not open
+                libusb_exit(context_);
+                handle_ = nullptr;
+                ::close(fd_);  // The open file is kept alive by the receiving process
+                fd_ = -1;
+            }
+        } else {  // The device was opened via libusb, which does not expose its file descriptor, so a new one is opened instead
+            int nodefd = ::open(usbfsPath().c_str(), O_RDWR | O_CLOEXEC);
+            if (nodefd == -1) {
+                ++errcnt;
+                errstr += "Could not open the device node.\n";
+            } else {
+                libusb_release_interface(handle_, 0);  // The interface must be released, so that the receiving process can claim it through the new file descriptor
+                if (!sendFD(socket, nodefd, flags)) {
+                    libusb_claim_interface(handle_, 0);  // Reclaim the interface, since the device stays open here
+                    ++errcnt;
+                    errstr += "Failed to hand off the device.\n";
+                } else {
+                    libusb_close(handle_);  // Close the device, without reattaching the kernel driver
+                    libusb_exit(context_);
+                    handle_ = nullptr;
+                }
+                ::close(nodefd);
+            }
+        }
+        if (!isOpen()) {
+            evttlm_.active = false;  // Event telemetry cannot go on without a device
+        }
+#else
+        (void)socket;
+        ++errcnt;
+        errstr += "In handOff(): handing off devices is only supported on Linux.\n";  // Program logic error
+#endif
+    }
+}
+
 // Returns true is the OTP ROM of the CP2130 was never written
 bool CP2130::isOTPBlank(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return getLockWord(errcnt, errstr) == 0xffff;
 }
 
 // Returns true is the OTP ROM of the CP2130 is locked
 bool CP2130::isOTPLocked(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return (LWALL & getLockWord(errcnt, errstr)) == 0x0000;  // Note that the reserved bits are ignored
 }
 
 // Returns true if a ReadWithRTR command is currently active
 bool CP2130::isRTRActive(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferIn[GET_RTR_STATE_WLEN];
     controlTransfer(GET, GET_RTR_STATE, 0x0000, 0x0000, controlBufferIn, GET_RTR_STATE_WLEN, errcnt, errstr);
     return controlBufferIn[0] == 0x01;
@@ -681,16 +2086,23 @@ bool CP2130::isRTRActive(int &errcnt, std::string &errstr)
 // Locks the OTP ROM of the CP2130, preventing further changes
 void CP2130::lockOTP(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     writeLockWord(0x0000, errcnt, errstr);  // Both lock bytes are set to zero
 }
 
 // Opens the device having the given VID, PID and, optionally, the given serial number, and assigns its handle
 // Since version 1.1.0, it is not required to specify a serial number
-int CP2130::open(uint16_t vid, uint16_t pid, const std::string &serial)
+// Since version 1.3.0, the backend can also be specified (the device is always found via libusb, but then handed over to usbfs if "backend" is set to "BACKEND_USBFS")
+// The usbfs backend is specific to Linux, so ERROR_INIT is returned if it is requested on any other platform
+int CP2130::open(uint16_t vid, uint16_t pid, const std::string &serial, uint8_t backend)
 {
     int retval;
     if (isOpen()) {  // Just in case the calling algorithm tries to open a device that was already sucessfully open, or tries to open different devices concurrently, all while using (or referencing to) the same object
         retval = SUCCESS;
+#ifndef __linux__
+    } else if (backend == BACKEND_USBFS) {  // The usbfs backend is specific to Linux
+        retval = ERROR_INIT;
+#endif
     } else if (libusb_init(&context_) != 0) {  // Initialize libusb. In case of failure
         retval = ERROR_INIT;
     } else {  // If libusb is initialized
@@ -705,7 +2117,16 @@ int CP2130::open(uint16_t vid, uint16_t pid, const std::string &serial)
         if (handle_ == nullptr) {  // If the previous operation fails to get a device handle
             libusb_exit(context_);  // Deinitialize libusb
             retval = ERROR_NOT_FOUND;
+#ifdef __linux__
+        } else if (backend == BACKEND_USBFS) {  // If the device is successfully opened, but the usbfs backend is to be used instead (since version 1.3.0)
+            backend_ = BACKEND_USBFS;
+            retval = usbfsOpen();
+            if (retval == SUCCESS) {
+                disconnected_ = false;
+            }
+#endif
         } else {  // If the device is successfully opened and a handle obtained
+            backend_ = BACKEND_LIBUSB;
             if (libusb_kernel_driver_active(handle_, 0) == 1) {  // If a kernel driver is active on the interface
                 libusb_detach_kernel_driver(handle_, 0);  // Detach the kernel driver
                 kernelWasAttached_ = true;  // Flag that the kernel driver was attached
@@ -726,18 +2147,220 @@ int CP2130::open(uint16_t vid, uint16_t pid, const std::string &serial)
             }
         }
     }
+    if (retval == SUCCESS) {  // The idle policy is applied to every device that is opened (since version 1.3.0)
+        int errcntIdle = 0;  // Errors are discarded, since the device is open anyway (see isAutosuspendEnabled())
+        std::string errstrIdle;
+        applyIdlePolicy(errcntIdle, errstrIdle);
+    }
+    return retval;
+}
+
+// Opens the device corresponding to the given usbfs file descriptor, which may have been inherited or received via takeOver() (added in version 1.3.0)
+// Unlike open(), this neither enumerates devices nor detaches the kernel driver, and claiming the interface is harmless if it is already claimed through the same open file
+// If successful, the file descriptor is owned by this object and closed by close(). Otherwise, it remains owned by the caller. Returns the same values as open()
+// Note that the libusb backend requires libusb_wrap_sys_device(), which is available since libusb 1.0.23, whereas the usbfs backend skips libusb altogether
+int CP2130::openFD(int fd, uint8_t backend, bool kernelWasAttached)
+{
+    int retval;
+    if (isOpen()) {  // Just in case the calling algorithm tries to open a device that was already sucessfully open
+        retval = SUCCESS;
+    } else if (fd < 0) {
+        retval = ERROR_NOT_FOUND;
+    } else if (backend == BACKEND_USBFS) {
+#ifdef __linux__
+        backend_ = BACKEND_USBFS;
+        kernelWasAttached_ = kernelWasAttached;  // Allows the kernel driver to be reattached by close(), as it would have been by the original owner
+        fd_ = fd;
+        retval = usbfsClaim();
+        if (retval == SUCCESS) {
+            disconnected_ = false;
+        } else {
+            fd_ = -1;  // Required to mark the device as closed, while leaving the file descriptor open
+        }
+#else
+        retval = ERROR_INIT;  // The usbfs backend is specific to Linux
+#endif
+    } else {
+#if LIBUSB_API_VERSION >= 0x01000107
+        if (libusb_init(&context_) != 0) {  // Initialize libusb. In case of failure
+            retval = ERROR_INIT;
+        } else if (libusb_wrap_sys_device(context_, static_cast<intptr_t>(fd), &handle_) != 0) {  // Obtain a device handle from the file descriptor. In case of failure
+            libusb_exit(context_);  // Deinitialize libusb
+            handle_ = nullptr;
+            retval = ERROR_NOT_FOUND;
+        } else if (libusb_claim_interface(handle_, 0) != 0) {  // Claim the interface. In case of failure
+            libusb_close(handle_);  // Close the device (the file descriptor is left open)
+            libusb_exit(context_);  // Deinitialize libusb
+            handle_ = nullptr;  // Required to mark the device as closed
+            retval = ERROR_BUSY;
+        } else {
+            backend_ = BACKEND_LIBUSB;
+            kernelWasAttached_ = kernelWasAttached;
+            fd_ = fd;  // Kept so that close() can close it, since libusb does not
+            disconnected_ = false;
+            retval = SUCCESS;
+        }
+#else
+        retval = ERROR_INIT;  // libusb_wrap_sys_device() is not available
+#endif
+    }
+    if (retval == SUCCESS) {  // The idle policy is applied to every device that is opened (since version 1.3.0)
+        int errcntIdle = 0;  // Errors are discarded, since the device is open anyway (see isAutosuspendEnabled())
+        std::string errstrIdle;
+        applyIdlePolicy(errcntIdle, errstrIdle);
+    }
+    return retval;
+}
+
+// Opens a device via the given transport, which may be a simulated one (added in version 1.3.0)
+// The transport is not owned by this object, and must outlive it, or at least remain valid until close() is called. Returns SUCCESS, or ERROR_NOT_FOUND if a null pointer is passed
+int CP2130::openTransport(Transport *transport)
+{
+    int retval;
+    if (isOpen()) {  // Just in case the calling algorithm tries to open a device that was already sucessfully open
+        retval = SUCCESS;
+    } else if (transport == nullptr) {
+        retval = ERROR_NOT_FOUND;
+    } else {
+        backend_ = BACKEND_TRANSPORT;
+        transport_ = transport;
+        clock_ = &transport->getTimeSource();  // Virtual time, if enabled, is confined to the transport (since version 1.3.0)
+        kernelWasAttached_ = false;
+        disconnected_ = false;
+        retval = SUCCESS;
+    }
+    if (retval == SUCCESS) {  // The idle policy is applied to every device that is opened (since version 1.3.0)
+        int errcntIdle = 0;  // Errors are discarded, since the device is open anyway (see isAutosuspendEnabled())
+        std::string errstrIdle;
+        applyIdlePolicy(errcntIdle, errstrIdle);
+    }
+    return retval;
+}
+
+// Reads the event counter and accumulates the events counted since the previous poll, returning the updated telemetry (added in version 1.3.0)
+// Note that at most one overflow can be detected between polls, so the counter should be polled before 65536 further events take place
+CP2130::EventTelemetry CP2130::pollEventTelemetry(int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    if (!evttlm_.active) {
+        ++errcnt;
+        errstr += "In pollEventTelemetry(): Event telemetry is not running.\n";  // Program logic error
+    } else {
+        int preverrcnt = errcnt;
+        EventCounter evtcntr = getEventCounter(errcnt, errstr);
+        std::chrono::steady_clock::time_point now = clock_->now();
+        if (errcnt == preverrcnt) {  // The counter value is only accounted for if it was read successfully
+            uint64_t events;
+            if (evtcntr.overflow) {  // If the counter has wrapped around since the previous poll
+                events = 0x10000 + evtcntr.value - evtLastValue_;
+                ++evttlm_.overflows;
+                setEventCounter({false, evttlm_.mode, evtcntr.value}, errcnt, errstr);  // Clear the overflow flag (any events between the previous read and this write are not counted)
+            } else if (evtcntr.value >= evtLastValue_) {
+                events = evtcntr.value - evtLastValue_;
+            } else {  // The counter was reset by other means
+                events = evtcntr.value;
+            }
+            evtLastValue_ = evtcntr.value;
+            evttlm_.total += events;
+            double interval = std::chrono::duration<double>(now - evtLastPoll_).count();
+            double elapsed = std::chrono::duration<double>(now - evtStart_).count();
+            evttlm_.rate = interval > 0 ? events / interval : 0;
+            evttlm_.avgrate = elapsed > 0 ? evttlm_.total / elapsed : 0;
+            evtLastPoll_ = now;
+        }
+    }
+    return evttlm_;
+}
+
+// Recovers a misbehaving device, by resetting it and reopening it once it re-enumerates, using the same backend (added in version 1.3.0)
+// The device is identified by its VID, PID and serial number, which are read beforehand, so it must still respond to control transfers
+// Returns the same values as open(), and the device remains closed in case of failure. Note that every setting that is not stored in the OTP ROM is lost
+int CP2130::recover(int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    int retval;
+    if (!isOpen()) {
+        ++errcnt;
+        errstr += "In recover(): device is not open.\n";  // Program logic error
+        retval = ERROR_NOT_FOUND;
+    } else if (backend_ == BACKEND_TRANSPORT) {  // A transport cannot be reopened, but it does not need to be, since it is not re-enumerated
+        reset(errcnt, errstr);
+        uint64_t recoveries = wdstatus_.recoveries + 1;
+        resetWatchdog();
+        wdstatus_.recoveries = recoveries;
+        retval = SUCCESS;
+    } else {
+        int preverrcnt = errcnt;
+        USBConfig config = getUSBConfig(errcnt, errstr);
+        std::u16string serial16 = getSerialDesc(errcnt, errstr);
+        if (errcnt != preverrcnt) {  // The device could not be identified, and so it is left as is
+            retval = ERROR_NOT_FOUND;
+        } else {
+            std::string serial;
+            for (char16_t character : serial16) {  // Serial numbers are assumed to be plain ASCII
+                serial += static_cast<char>(character);
+            }
+            uint8_t backend = backend_;
+            int errcntReset = 0;  // The reset request may fail as the device disconnects, so its errors are discarded
+            std::string errstrReset;
+            reset(errcntReset, errstrReset);
+            close();
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(RCV_TIMEOUT);
+            do {
+                std::this_thread::sleep_for(std::chrono::milliseconds(RCV_RETRY));  // Give the device time to re-enumerate
+                retval = open(config.vid, config.pid, serial, backend);
+            } while (retval != SUCCESS && std::chrono::steady_clock::now() < deadline);
+            if (retval == SUCCESS) {
+                uint64_t recoveries = wdstatus_.recoveries + 1;
+                resetWatchdog();  // The baselines are established again, from scratch
+                wdstatus_.recoveries = recoveries;
+            } else {
+                ++errcnt;
+                errstr += "Failed to reopen the device after resetting it.\n";
+            }
+        }
+    }
     return retval;
 }
 
 // Issues a reset to the CP2130
 void CP2130::reset(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     controlTransfer(SET, RESET_DEVICE, 0x0000, 0x0000, nullptr, RESET_DEVICE_WLEN, errcnt, errstr);
+    csSelected_ = 0xff;  // Every chip select is disabled by the reset (since version 1.3.0)
+}
+
+// Discards the operation profiles (added in version 1.3.0)
+void CP2130::resetOperationProfiles()
+{
+    profiler_.reset();
+}
+
+// Resets the transfer statistics (added in version 1.3.0)
+void CP2130::resetTransferStats()
+{
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    stats_ = TransferStats();
+    fitCount_ = 0;  // Calibration data is reset as well
+    fitBytes_ = 0;
+    fitTime_ = 0;
+    fitBytesTime_ = 0;
+    fitBytesSquared_ = 0;
+}
+
+// Resets the watchdog, clearing its baselines and counters (added in version 1.3.0)
+void CP2130::resetWatchdog()
+{
+    wdstatus_ = WatchdogStatus();
+    wdVariance_ = 0;
+    wdConsecutive_ = 0;
 }
 
 // Enables the chip select of the target channel, disabling any others
 void CP2130::selectCS(uint8_t channel, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     if (channel > 10) {
         ++errcnt;
         errstr += "In selectCS(): SPI channel value must be between 0 and 10.\n";  // Program logic error
@@ -746,13 +2369,45 @@ void CP2130::selectCS(uint8_t channel, int &errcnt, std::string &errstr)
             channel,  // Selected channel
             0x02      // Only the corresponding chip select is enabled, all the others are disabled
         };
+        int preverrcnt = errcnt;
         controlTransfer(SET, SET_GPIO_CHIP_SELECT, 0x0000, 0x0000, controlBufferOut, SET_GPIO_CHIP_SELECT_WLEN, errcnt, errstr);
+        csSelected_ = errcnt == preverrcnt ? channel : 0xff;  // Keep track of the selected channel, which is used to coalesce writes (since version 1.3.0)
+    }
+}
+
+// Enables or disables USB autosuspend for the device, by writing to its "power/control" attribute in sysfs (added in version 1.3.0)
+// Disabling autosuspend spares the first transfer after an idle period from waiting for the device (and possibly its hub) to resume, but this requires write access to sysfs (e.g., granted by a udev rule)
+// Note that the setting belongs to the device, and so it outlasts this object
+void CP2130::setAutosuspend(bool enabled, int &errcnt, std::string &errstr)
+{
+#ifdef __linux__
+    std::string path = sysfsPath();
+    if (path.empty()) {
+        ++errcnt;
+        errstr += "In setAutosuspend(): device is not open, or it was opened via a transport.\n";  // Program logic error
+    } else {
+        path += "/power/control";
+        const char *value = enabled ? "auto" : "on";
+        int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd == -1 || ::write(fd, value, std::strlen(value)) != static_cast<ssize_t>(std::strlen(value))) {
+            ++errcnt;
+            errstr += "Could not write to \"" + path + "\".\n";
+        }
+        if (fd != -1) {
+            ::close(fd);
+        }
     }
+#else
+    (void)enabled;
+    ++errcnt;
+    errstr += "In setAutosuspend(): autosuspend control is only supported on Linux.\n";  // Program logic error
+#endif
 }
 
 // Sets the clock divider value
 void CP2130::setClockDivider(uint8_t value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferOut[SET_CLOCK_DIVIDER_WLEN] = {
         value  // Intended clock divider value (GPIO.5 clock frequency = 24 MHz / divider)
     };
@@ -762,6 +2417,7 @@ void CP2130::setClockDivider(uint8_t value, int &errcnt, std::string &errstr)
 // Sets the event counter
 void CP2130::setEventCounter(const EventCounter &evcntr, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferOut[SET_EVENT_COUNTER_WLEN] = {
         static_cast<uint8_t>(0x07 & evcntr.mode),                                    // Set GPIO.4/EVTCNTR pin mode
         static_cast<uint8_t>(evcntr.value >> 8), static_cast<uint8_t>(evcntr.value)  // Set the event count value
@@ -772,6 +2428,7 @@ void CP2130::setEventCounter(const EventCounter &evcntr, int &errcnt, std::strin
 // Sets the full FIFO threshold
 void CP2130::setFIFOThreshold(uint8_t threshold, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferOut[SET_FULL_THRESHOLD_WLEN] = {
         threshold  // Intended FIFO threshold
     };
@@ -781,83 +2438,163 @@ void CP2130::setFIFOThreshold(uint8_t threshold, int &errcnt, std::string &errst
 // Sets the GPIO.0 pin on the CP2130 to a given value
 void CP2130::setGPIO0(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO0, errcnt, errstr);
 }
 
 // Sets the GPIO.1 pin on the CP2130 to a given value
 void CP2130::setGPIO1(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO1, errcnt, errstr);
 }
 
 // Sets the GPIO.2 pin on the CP2130 to a given value
 void CP2130::setGPIO2(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO2, errcnt, errstr);
 }
 
 // Sets the GPIO.3 pin on the CP2130 to a given value
 void CP2130::setGPIO3(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO3, errcnt, errstr);
 }
 
 // Sets the GPIO.4 pin on the CP2130 to a given value
 void CP2130::setGPIO4(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO4, errcnt, errstr);
 }
 
 // Sets the GPIO.5 pin on the CP2130 to a given value
 void CP2130::setGPIO5(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO5, errcnt, errstr);
 }
 
 // Sets the GPIO.6 pin on the CP2130 to a given value
 void CP2130::setGPIO6(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO6, errcnt, errstr);
 }
 
 // Sets the GPIO.7 pin on the CP2130 to a given value
 void CP2130::setGPIO7(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO7, errcnt, errstr);
 }
 
 // Sets the GPIO.8 pin on the CP2130 to a given value
 void CP2130::setGPIO8(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO8, errcnt, errstr);
 }
 
 // Sets the GPIO.9 pin on the CP2130 to a given value
 void CP2130::setGPIO9(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO9, errcnt, errstr);
 }
 
 // Sets the GPIO.10 pin on the CP2130 to a given value
 void CP2130::setGPIO10(bool value, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     setGPIOs(BMGPIOS * value, BMGPIO10, errcnt, errstr);
 }
 
 // Sets one or more GPIO pins on the CP2130 to the intended values, according to the values and mask bitmaps
+// If GPIO writes are being combined, the write is deferred and merged with the other pending writes (see beginGPIOBatch() for details)
 void CP2130::setGPIOs(uint16_t bmValues, uint16_t bmMask, int &errcnt, std::string &errstr)
 {
-    unsigned char controlBufferOut[SET_GPIO_VALUES_WLEN] = {
-        static_cast<uint8_t>((BMGPIOS & bmValues) >> 8), static_cast<uint8_t>(BMGPIOS & bmValues),  // GPIO values bitmap
-        static_cast<uint8_t>((BMGPIOS & bmMask) >> 8), static_cast<uint8_t>(BMGPIOS & bmMask)       // Mask bitmap
-    };
-    controlTransfer(SET, SET_GPIO_VALUES, 0x0000, 0x0000, controlBufferOut, SET_GPIO_VALUES_WLEN, errcnt, errstr);
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    if (gpioBatching_) {  // Write combining was implemented in version 1.3.0
+        if ((BMGPIOS & bmMask & gpioPendingMask_) != 0x0000) {  // If any of the given pins already has a pending write
+            flushGPIOs(errcnt, errstr);  // Send the pending writes first, so that no edge is lost
+        }
+        gpioPendingValues_ = static_cast<uint16_t>((~bmMask & gpioPendingValues_) | (BMGPIOS & bmMask & bmValues));
+        gpioPendingMask_ = static_cast<uint16_t>(gpioPendingMask_ | (BMGPIOS & bmMask));
+    } else {
+        unsigned char controlBufferOut[SET_GPIO_VALUES_WLEN] = {
+            static_cast<uint8_t>((BMGPIOS & bmValues) >> 8), static_cast<uint8_t>(BMGPIOS & bmValues),  // GPIO values bitmap
+            static_cast<uint8_t>((BMGPIOS & bmMask) >> 8), static_cast<uint8_t>(BMGPIOS & bmMask)       // Mask bitmap
+        };
+        controlTransfer(SET, SET_GPIO_VALUES, 0x0000, 0x0000, controlBufferOut, SET_GPIO_VALUES_WLEN, errcnt, errstr);
+    }
+}
+
+// Sets the idle policy, which is applied right away if the device is open, and then whenever the device is opened (added in version 1.3.0)
+// Keepalives are issued by a separate thread, which sends a Get_GPIO_Values request whenever the device sits idle for longer than the keepalive interval, and which stays out of the way of any transfer in progress
+// The latency of first transfers is reported apart from the steady-state latency (see TransferStats), so that the effect of the policy can be assessed. Note that autosuspend is never re-enabled by this function
+void CP2130::setIdlePolicy(const IdlePolicy &policy, int &errcnt, std::string &errstr)
+{
+    if (policy.idle < 0 || policy.keepalive < 0) {
+        ++errcnt;
+        errstr += "In setIdlePolicy(): Idle time and keepalive interval must not be negative.\n";  // Program logic error
+    } else {
+        stopKeepalive();  // The keepalive thread is restarted, if required, so that it follows the new policy
+        idlepolicy_ = policy;
+        if (isOpen()) {
+            applyIdlePolicy(errcnt, errstr);
+        }
+    }
+}
+
+// Enables or disables profiling (added in version 1.3.0)
+// While enabled, each public operation that communicates with the device records its host CPU time, wall-clock time, transfers and bytes, aggregated by function name (see getOperationProfiles())
+// Comparing both times tells if an operation is bound by host code or by USB waits, and the transfer count tells how much of it can be saved by batching
+void CP2130::setProfiling(bool enabled)
+{
+    profiler_.setEnabled(enabled);
+}
+
+// Sets the timing model, in alternative to calibrateTimingModel() (added in version 1.3.0)
+void CP2130::setTimingModel(const TimingModel &model)
+{
+    timing_ = model;
+}
+
+// Sets the watchdog policy, which enables or disables the watchdog as well (added in version 1.3.0)
+// Note that the baselines are kept, unless resetWatchdog() is called
+void CP2130::setWatchdogPolicy(const WatchdogPolicy &policy)
+{
+    wdpolicy_ = policy;
+}
+
+// Enables or disables write coalescing for the given channel (added in version 1.3.0)
+// While enabled, consecutive spiWrite() calls issued while the channel is the one selected via selectCS() are merged into a single Write command, which is only sent on the next transfer of any kind, or via flushWrites()
+// This should only be enabled for devices that accept back-to-back frames without the chip select being toggled between them. Note that errors are only reported once the writes are sent, and that any delays between the merged writes are not preserved
+void CP2130::setWriteCoalescing(uint8_t channel, bool enabled, int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    if (channel > 10) {
+        ++errcnt;
+        errstr += "In setWriteCoalescing(): SPI channel value must be between 0 and 10.\n";  // Program logic error
+    } else {
+        if (!enabled) {
+            flushWrites(errcnt, errstr);  // Nothing is left behind
+            wcChannels_ = static_cast<uint16_t>(~(0x0001 << channel) & wcChannels_);
+        } else {
+            wcChannels_ = static_cast<uint16_t>(0x0001 << channel | wcChannels_);
+        }
+    }
 }
 
 // Requests and reads the given number of bytes from the SPI bus, and then returns a vector
 // This is the prefered method of reading from the bus, if both endpoint addresses are known
 std::vector<uint8_t> CP2130::spiRead(uint32_t bytesToRead, uint8_t endpointInAddr, uint8_t endpointOutAddr, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char readCommandBuffer[8] = {
         0x00, 0x00,    // Reserved
         CP2130::READ,  // Read command
@@ -873,53 +2610,48 @@ std::vector<uint8_t> CP2130::spiRead(uint32_t bytesToRead, uint8_t endpointInAdd
     int bytesWritten;
     bulkTransfer(endpointOutAddr, readCommandBuffer, static_cast<int>(sizeof(readCommandBuffer)), &bytesWritten, errcnt, errstr);
 #endif
-    unsigned char *readInputBuffer = new unsigned char[bytesToRead];  // Allocated dynamically since version 1.1.0
+    unsigned char *readInputBuffer = reserveBuffer(bytesToRead);  // Reusable buffer since version 1.3.0 (it was allocated dynamically on each call from version 1.1.0 onwards)
     int bytesRead = 0;  // Important!
     bulkTransfer(endpointInAddr, readInputBuffer, static_cast<int>(bytesToRead), &bytesRead, errcnt, errstr);
-    std::vector<uint8_t> retdata(static_cast<size_t>(bytesRead));
-    for (int i = 0; i < bytesRead; ++i) {
-        retdata[i] = readInputBuffer[i];
-    }
-    delete[] readInputBuffer;
+    std::vector<uint8_t> retdata(readInputBuffer, readInputBuffer + bytesRead);
     return retdata;
 }
 
 // This function is a shorthand version of the previous one (both endpoint addresses are automatically deduced, at the cost of decreased speed)
 std::vector<uint8_t> CP2130::spiRead(uint32_t bytesToRead, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return spiRead(bytesToRead, getEndpointInAddr(errcnt, errstr), getEndpointOutAddr(errcnt, errstr), errcnt, errstr);
 }
 
 // Writes to the SPI bus, using the given vector
 // This is the prefered method of writing to the bus, if the endpoint OUT address is known
+// Since version 1.3.0, the write is held back and merged with the following ones, if write coalescing is enabled for the selected channel (see setWriteCoalescing())
 void CP2130::spiWrite(const std::vector<uint8_t> &data, uint8_t endpointOutAddr, int &errcnt, std::string &errstr)
 {
-    uint32_t bytesToWrite = static_cast<uint32_t>(data.size());
-    int bufSize = bytesToWrite + 8;
-    unsigned char *writeCommandBuffer = new unsigned char[bufSize] {  // Allocated dynamically since version 1.1.0
-        0x00, 0x00,     // Reserved
-        CP2130::WRITE,  // Write command
-        0x00,           // Reserved
-        static_cast<uint8_t>(bytesToWrite),
-        static_cast<uint8_t>(bytesToWrite >> 8),
-        static_cast<uint8_t>(bytesToWrite >> 16),
-        static_cast<uint8_t>(bytesToWrite >> 24)
-    };
-    for (size_t i = 0; i < bytesToWrite; ++i) {
-        writeCommandBuffer[i + 8] = data[i];
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    if (csSelected_ != 0xff && (0x0001 << csSelected_ & wcChannels_) != 0x0000) {
+        if (gpioPendingMask_ != 0x0000) {  // Any pending GPIO writes must take place before this write, and this sends any pending SPI writes as well
+            flushGPIOs(errcnt, errstr);
+        }
+        if (!wcPending_.empty() && wcEndpoint_ != endpointOutAddr) {
+            flushWrites(errcnt, errstr);
+        }
+        if (!wcPending_.empty()) {
+            ++stats_.coalesced;
+        }
+        wcEndpoint_ = endpointOutAddr;
+        wcPending_.insert(wcPending_.end(), data.begin(), data.end());
+    } else {
+        writeCommand(data.data(), data.size(), endpointOutAddr, errcnt, errstr);
     }
-#if LIBUSB_API_VERSION >= 0x01000105
-    bulkTransfer(endpointOutAddr, writeCommandBuffer, bufSize, nullptr, errcnt, errstr);
-#else
-    int bytesWritten;
-    bulkTransfer(endpointOutAddr, writeCommandBuffer, bufSize, &bytesWritten, errcnt, errstr);
-#endif
-    delete[] writeCommandBuffer;
 }
 
 // This function is a shorthand version of the previous one (the endpoint OUT address is automatically deduced at the cost of decreased speed)
 void CP2130::spiWrite(const std::vector<uint8_t> &data, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     spiWrite(data, getEndpointOutAddr(errcnt, errstr), errcnt, errstr);
 }
 
@@ -927,6 +2659,7 @@ void CP2130::spiWrite(const std::vector<uint8_t> &data, int &errcnt, std::string
 // This is the prefered method of writing and reading, if both endpoint addresses are known
 std::vector<uint8_t> CP2130::spiWriteRead(const std::vector<uint8_t> &data, uint8_t endpointInAddr, uint8_t endpointOutAddr, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     size_t bytesToWriteRead = data.size();
     size_t bytesProcessed = 0;  // Loop control variable implemented in version 1.2.3, to replace "bytesLeft"
     std::vector<uint8_t> retdata;
@@ -935,7 +2668,7 @@ std::vector<uint8_t> CP2130::spiWriteRead(const std::vector<uint8_t> &data, uint
         size_t bytesRemaining = bytesToWriteRead - bytesProcessed;  // Equivalent to the variable "bytesLeft" found in version 1.2.2, except that it is no longer used for control
         uint32_t payload = static_cast<uint32_t>(bytesRemaining > 56 ? 56 : bytesRemaining);
         int bufSize = payload + 8;
-        unsigned char *writeReadCommandBuffer = new unsigned char[bufSize] {
+        unsigned char writeReadCommandBuffer[64] = {  // Since version 1.3.0, both buffers are allocated on the stack, given that their sizes are bounded by the 56-byte payload
             0x00, 0x00,         // Reserved
             CP2130::WRITEREAD,  // WriteRead command
             0x00,               // Reserved
@@ -953,8 +2686,7 @@ std::vector<uint8_t> CP2130::spiWriteRead(const std::vector<uint8_t> &data, uint
         int bytesWritten;
         bulkTransfer(endpointOutAddr, writeReadCommandBuffer, bufSize, &bytesWritten, errcnt, errstr);
 #endif
-        delete[] writeReadCommandBuffer;
-        unsigned char *writeReadInputBuffer = new unsigned char[payload];
+        unsigned char writeReadInputBuffer[56];
         int bytesRead = 0;  // Important!
         bulkTransfer(endpointInAddr, writeReadInputBuffer, payload, &bytesRead, errcnt, errstr);
         size_t prevretdataSize = retdata.size();
@@ -962,7 +2694,6 @@ std::vector<uint8_t> CP2130::spiWriteRead(const std::vector<uint8_t> &data, uint
         for (int i = 0; i < bytesRead; ++i) {
             retdata[prevretdataSize + i] = writeReadInputBuffer[i];  // Note that std::vector::push_back() is no longer used since version 1.2.2, because it is more efficient to resize the vector only once per iteration (see above), so that the values may be simply assigned (fixed in version 1.2.3)
         }
-        delete[] writeReadInputBuffer;
         bytesProcessed += payload;  // Note that, since version 1.2.3, the loop control variable is added to (it is generaly a bad idea to subtract from a unsigned variable, because it can lead to a overflow that may go unchecked)
     }
     return retdata;
@@ -971,21 +2702,171 @@ std::vector<uint8_t> CP2130::spiWriteRead(const std::vector<uint8_t> &data, uint
 // This function is a shorthand version of the previous one (both endpoint addresses are automatically deduced, at the cost of decreased speed)
 std::vector<uint8_t> CP2130::spiWriteRead(const std::vector<uint8_t> &data, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     return spiWriteRead(data, getEndpointInAddr(errcnt, errstr), getEndpointOutAddr(errcnt, errstr), errcnt, errstr);
 }
 
+// Writes to the SPI bus while reading back, as spiWriteRead() does, except that the stream can be cancelled via cancel() between consecutive WriteRead commands (added in version 1.3.0)
+// The returned vector holds the bytes read back so far, and "result" reports how many bytes were exchanged, and whether the stream was cancelled
+std::vector<uint8_t> CP2130::spiWriteReadStream(const std::vector<uint8_t> &data, uint8_t endpointInAddr, uint8_t endpointOutAddr, StreamResult &result, int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    result = {0, false};
+    cancelRequested_ = false;  // Only requests made while the stream is in progress are honored
+    std::vector<uint8_t> retdata;
+    int preverrcnt = errcnt;
+    while (result.bytes < data.size() && preverrcnt == errcnt) {
+        if (cancelRequested_) {
+            result.cancelled = true;
+            break;
+        }
+        size_t payload = std::min(data.size() - result.bytes, static_cast<size_t>(56));  // Same payload as the one used by spiWriteRead(), so that each command takes little time
+        std::vector<uint8_t> chunk = spiWriteRead(std::vector<uint8_t>(data.begin() + result.bytes, data.begin() + result.bytes + payload), endpointInAddr, endpointOutAddr, errcnt, errstr);
+        retdata.insert(retdata.end(), chunk.begin(), chunk.end());
+        if (preverrcnt == errcnt) {
+            result.bytes += payload;
+        }
+    }
+    return retdata;
+}
+
+// Writes to the SPI bus in segments of the given size, each one sent as a separate Write command, so that the stream can be preempted via cancel() (added in version 1.3.0)
+// If the stream is cancelled, the segment in flight is cancelled as well. Should that segment be partially sent, its remainder is still sent, given that the CP2130 expects the whole payload announced by the command. Therefore, the stream always stops at a segment boundary, and "bytes" reports exactly how many bytes were written
+// As with spiWrite(), the chip select must be managed by the caller, and it stays enabled across segments
+CP2130::StreamResult CP2130::spiWriteStream(const std::vector<uint8_t> &data, uint8_t endpointOutAddr, size_t segmentSize, int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    std::lock_guard<std::recursive_mutex> lock(ioMutex_);
+    StreamResult result = {0, false};
+    if (segmentSize == 0) {
+        ++errcnt;
+        errstr += "In spiWriteStream(): Segment size must be greater than zero.\n";  // Program logic error
+    } else if (!isOpen()) {
+        ++errcnt;
+        errstr += "In spiWriteStream(): device is not open.\n";  // Program logic error
+    } else {
+        if (gpioPendingMask_ != 0x0000) {  // Any pending GPIO writes must be sent before the stream
+            flushGPIOs(errcnt, errstr);
+        }
+        flushWrites(errcnt, errstr);  // As well as any pending SPI writes
+        if (urbsPending_ != 0) {  // And any pending transfers
+            flushTransfers(errcnt, errstr);
+        }
+        cancelRequested_ = false;  // Only requests made while the stream is in progress are honored
+        int preverrcnt = errcnt;
+        while (result.bytes < data.size() && preverrcnt == errcnt) {
+            if (cancelRequested_) {
+                result.cancelled = true;
+                break;
+            }
+            uint32_t payload = static_cast<uint32_t>(std::min(data.size() - result.bytes, segmentSize));
+            int bufSize = static_cast<int>(payload + 8);
+            unsigned char *writeCommandBuffer = reserveBuffer(static_cast<size_t>(bufSize));
+            writeCommandBuffer[0] = 0x00;  // Reserved
+            writeCommandBuffer[1] = 0x00;
+            writeCommandBuffer[2] = CP2130::WRITE;  // Write command
+            writeCommandBuffer[3] = 0x00;  // Reserved
+            writeCommandBuffer[4] = static_cast<uint8_t>(payload);
+            writeCommandBuffer[5] = static_cast<uint8_t>(payload >> 8);
+            writeCommandBuffer[6] = static_cast<uint8_t>(payload >> 16);
+            writeCommandBuffer[7] = static_cast<uint8_t>(payload >> 24);
+            std::copy(data.begin() + result.bytes, data.begin() + result.bytes + payload, writeCommandBuffer + 8);
+            int bytesWritten = 0;
+            int status = streamSegment(endpointOutAddr, writeCommandBuffer, bufSize, &bytesWritten);
+            lastActivity_ = clock_->now();
+            if (status == LIBUSB_ERROR_INTERRUPTED && bytesWritten > 0 && bytesWritten < bufSize) {  // The segment was cut short, so it must be completed (this transfer is not cancellable)
+                bulkTransfer(endpointOutAddr, writeCommandBuffer + bytesWritten, bufSize - bytesWritten, nullptr, errcnt, errstr);
+                bytesWritten = bufSize;
+            } else if (status != 0 && status != LIBUSB_ERROR_INTERRUPTED) {
+                ++errcnt;
+                char message[MSG_BUFFER_SIZE];
+                std::snprintf(message, sizeof(message), "Failed bulk OUT transfer to endpoint %u (address 0x%02x).\n", 0x0f & endpointOutAddr, endpointOutAddr);
+                errstr += message;
+            }
+            if (preverrcnt == errcnt && bytesWritten == bufSize) {
+                result.bytes += payload;
+            } else if (status == LIBUSB_ERROR_INTERRUPTED) {  // Nothing from this segment was sent
+                result.cancelled = true;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+// Starts counting events on the GPIO.4/EVTCNTR pin, according to the given mode, and accumulates them into 64-bit totals (added in version 1.3.0)
+// The mode should be one of "PCEVTCNTRRE" [0x04], "PCEVTCNTRFE" [0x05], "PCEVTCNTRNP" [0x06] or "PCEVTCNTRPP" [0x07], and GPIO.4 must be configured as EVTCNTR in the OTP ROM
+void CP2130::startEventTelemetry(uint8_t mode, int &errcnt, std::string &errstr)
+{
+    Profiler::Scope profile(profiler_, *this, __func__);
+    if (mode < PCEVTCNTRRE || mode > PCEVTCNTRPP) {
+        ++errcnt;
+        errstr += "In startEventTelemetry(): Event counter mode must be between 4 and 7.\n";  // Program logic error
+    } else {
+        int preverrcnt = errcnt;
+        PinConfig config = getPinConfig(errcnt, errstr);
+        if (errcnt == preverrcnt && config.gpio4 < PCEVTCNTRRE) {
+            ++errcnt;
+            errstr += "In startEventTelemetry(): GPIO.4 is not configured as an event counter input.\n";
+        } else if (errcnt == preverrcnt) {
+            setEventCounter({false, mode, 0x0000}, errcnt, errstr);  // Set the event counter mode and clear the count, along with the overflow flag
+            evttlm_ = {errcnt == preverrcnt, mode, 0, 0, 0, 0};
+            evtLastValue_ = 0x0000;
+            evtStart_ = clock_->now();
+            evtLastPoll_ = evtStart_;
+        }
+    }
+}
+
+// Stops accumulating events (added in version 1.3.0)
+// Note that the totals are kept, and they can still be obtained via getEventTelemetry()
+void CP2130::stopEventTelemetry()
+{
+    evttlm_.active = false;
+}
+
 // Aborts the current ReadWithRTR command
 void CP2130::stopRTR(int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferOut[SET_RTR_STOP_WLEN] = {
         0x01  // Abort current ReadWithRTR command
     };
     controlTransfer(SET, SET_RTR_STOP, 0x0000, 0x0000, controlBufferOut, SET_RTR_STOP_WLEN, errcnt, errstr);
 }
 
+// Takes over a device handed off by another process via handOff(), receiving the file descriptor of its usbfs device node over the given Unix domain socket (added in version 1.3.0)
+// Returns the same values as open(), or ERROR_NOT_FOUND if no file descriptor could be received (ERROR_INIT is returned on platforms other than Linux)
+int CP2130::takeOver(int socket, uint8_t backend)
+{
+    int retval;
+    if (isOpen()) {  // Just in case the calling algorithm tries to open a device that was already sucessfully open
+        retval = SUCCESS;
+    } else {
+#ifdef __linux__
+        uint8_t flags = 0x00;
+        int fd = receiveFD(socket, flags);
+        if (fd == -1) {
+            retval = ERROR_NOT_FOUND;
+        } else {
+            retval = openFD(fd, backend, (HOFLAG_KERNEL & flags) != 0x00);
+            if (retval != SUCCESS) {
+                ::close(fd);  // The file descriptor is not passed back to the sending process
+            }
+        }
+#else
+        (void)socket;
+        (void)backend;
+        retval = ERROR_INIT;  // Handing off devices is specific to Linux
+#endif
+    }
+    return retval;
+}
+
 // This procedure is used to lock fields in the CP2130 OTP ROM - Use with care!
 void CP2130::writeLockWord(uint16_t word, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferOut[SET_LOCK_BYTE_WLEN] = {
         static_cast<uint8_t>(word), static_cast<uint8_t>(word >> 8)  // Sets both lock bytes to the intended value
     };
@@ -995,6 +2876,7 @@ void CP2130::writeLockWord(uint16_t word, int &errcnt, std::string &errstr)
 // Writes the manufacturer descriptor to the CP2130 OTP ROM
 void CP2130::writeManufacturerDesc(const std::u16string &manufacturer, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     if (manufacturer.size() > DESCMXL_MANUFACTURER) {
         ++errcnt;
         errstr += "In writeManufacturerDesc(): manufacturer descriptor string cannot be longer than 62 characters.\n";  // Program logic error
@@ -1006,6 +2888,7 @@ void CP2130::writeManufacturerDesc(const std::u16string &manufacturer, int &errc
 // Writes the pin configuration to the CP2130 OTP ROM
 void CP2130::writePinConfig(const PinConfig &config, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferOut[SET_PIN_CONFIG_WLEN] = {
         config.gpio0,                                                                                // GPIO.0 pin config
         config.gpio1,                                                                                // GPIO.1 pin config
@@ -1030,6 +2913,7 @@ void CP2130::writePinConfig(const PinConfig &config, int &errcnt, std::string &e
 // Writes the product descriptor to the CP2130 OTP ROM
 void CP2130::writeProductDesc(const std::u16string &product, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     if (product.size() > DESCMXL_PRODUCT) {
         ++errcnt;
         errstr += "In writeProductDesc(): product descriptor string cannot be longer than 62 characters.\n";  // Program logic error
@@ -1041,6 +2925,7 @@ void CP2130::writeProductDesc(const std::u16string &product, int &errcnt, std::s
 // Writes over the entire CP2130 OTP ROM
 void CP2130::writePROMConfig(const PROMConfig &config, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     for (size_t i = 0; i < PROM_BLOCKS; ++i) {
         unsigned char controlBufferOut[SET_PROM_CONFIG_WLEN];
         for (size_t j = 0; j < PROM_BLOCK_SIZE; ++j) {
@@ -1053,6 +2938,7 @@ void CP2130::writePROMConfig(const PROMConfig &config, int &errcnt, std::string
 // Writes the serial descriptor to the CP2130 OTP ROM
 void CP2130::writeSerialDesc(const std::u16string &serial, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     if (serial.size() > DESCMXL_SERIAL) {
         ++errcnt;
         errstr += "In writeSerialDesc(): serial descriptor string cannot be longer than 30 characters.\n";  // Program logic error
@@ -1064,6 +2950,7 @@ void CP2130::writeSerialDesc(const std::u16string &serial, int &errcnt, std::str
 // Writes the USB configuration to the CP2130 OTP ROM
 void CP2130::writeUSBConfig(const USBConfig &config, uint8_t mask, int &errcnt, std::string &errstr)
 {
+    Profiler::Scope profile(profiler_, *this, __func__);
     unsigned char controlBufferOut[SET_USB_CONFIG_WLEN] = {
         static_cast<uint8_t>(config.vid), static_cast<uint8_t>(config.vid >> 8),  // VID
         static_cast<uint8_t>(config.pid), static_cast<uint8_t>(config.pid >> 8),  // PID
@@ -1091,16 +2978,40 @@ std::list<std::string> CP2130::listDevices(uint16_t vid, uint16_t pid, int &errc
             ++errcnt;
             errstr += "Failed to retrieve a list of devices.\n";
         } else {
+            struct Candidate {
+                std::vector<uint8_t> location;  // Bus number, followed by the port numbers leading to the device
+                libusb_device *device;
+                uint8_t index;                  // Index of the serial number string descriptor
+            };
+            std::vector<Candidate> candidates;
             for (ssize_t i = 0; i < devlist; ++i) {  // Run through all listed devices
                 libusb_device_descriptor desc;
                 if (libusb_get_device_descriptor(devs[i], &desc) == 0 && desc.idVendor == vid && desc.idProduct == pid) {  // If the device descriptor is retrieved, and both VID and PID correspond to the respective given values
-                    libusb_device_handle *handle;
-                    if (libusb_open(devs[i], &handle) == 0) {  // Open the listed device. If successfull
-                        unsigned char str_desc[256];
-                        libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, str_desc, static_cast<int>(sizeof(str_desc)));  // Get the serial number string in ASCII format
-                        devices.push_back(reinterpret_cast<char *>(str_desc));  // Add the serial number string to the list
-                        libusb_close(handle);  // Close the device
+                    uint8_t ports[7];  // As per the USB 3.0 specification, the tier depth is limited to seven
+                    int depth = libusb_get_port_numbers(devs[i], ports, static_cast<int>(sizeof(ports)));
+                    Candidate candidate = {{libusb_get_bus_number(devs[i])}, devs[i], desc.iSerialNumber};
+                    candidate.location.insert(candidate.location.end(), ports, ports + (depth > 0 ? depth : 0));
+                    candidates.push_back(candidate);
+                }
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {return a.location < b.location;});  // Sort the devices by bus and port, so that the order of the list is stable (since version 1.3.0)
+            std::vector<std::string> serials(candidates.size());
+            std::vector<uint8_t> found(candidates.size(), 0);  // Not a vector of booleans, since its elements are written concurrently
+            std::atomic<size_t> next(0);
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < std::min(candidates.size(), LST_THREADS); ++i) {  // Probe the devices concurrently, since opening each one and reading its serial number may take several milliseconds (since version 1.3.0)
+                workers.push_back(std::thread([&] {
+                    for (size_t j = next++; j < candidates.size(); j = next++) {
+                        found[j] = probeSerial(candidates[j].device, candidates[j].index, serials[j]);
                     }
+                }));
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                if (found[i] != 0) {  // Devices that could not be opened, or that did not return their serial number in time, are left out
+                    devices.push_back(serials[i]);  // Add the serial number string to the list
                 }
             }
             libusb_free_device_list(devs, 1);  // Free device list
@@ -1109,3 +3020,9 @@ std::list<std::string> CP2130::listDevices(uint16_t vid, uint16_t pid, int &errc
     }
     return devices;
 }
+
+// Helper function that returns the SPI clock frequency (in Hz) corresponding to a given clock frequency value (added in version 1.3.0)
+double CP2130::spiClockFrequency(uint8_t cfrq)
+{
+    return SPI_MAXCLK / (1 << (0x07 & cfrq));
+}
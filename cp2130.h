@@ -1,4 +1,4 @@
-/* CP2130 class - Version 1.2.5
+/* CP2130 class - Version 1.3.0
    Copyright (c) 2021-2022 Samuel Lourenço
 
    This library is free software: you can redistribute it and/or modify it
@@ -22,22 +22,250 @@
 #define CP2130_H
 
 // Includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <list>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <libusb-1.0/libusb.h>
 
+struct usbdevfs_urb;  // Defined in <linux/usbdevice_fs.h>, which is only required by the usbfs backend (added in version 1.3.0)
+class TimeSource;    // Defined in "timesource.h" (added in version 1.3.0)
+
 class CP2130
 {
+public:
+    // Number of buckets used by LatencyStats
+    static const size_t LATENCY_BUCKETS = 200;
+
+    struct LatencyStats {
+        uint64_t count;                     // Number of samples
+        double min;                         // Minimum value (in us)
+        double max;                         // Maximum value (in us)
+        double sum;                         // Sum of all values (in us)
+        uint64_t buckets[LATENCY_BUCKETS];  // Logarithmic histogram, having eight buckets per octave (values up to 16.7s are resolved)
+
+        LatencyStats();
+
+        void add(double latency);
+        double mean() const;
+        double percentile(double fraction) const;
+    };
+
+    // Interface implemented by transports other than libusb and usbfs, such as simulated ones (added in version 1.3.0)
+    // Both transfer functions should return the same values as their libusb counterparts, and getTimeSource() should return the clock followed by the transport, which is real time by default
+    class Transport
+    {
+    public:
+        virtual ~Transport();
+
+        virtual int bulkTransfer(uint8_t endpointAddr, unsigned char *data, int length, int *transferred) = 0;
+        virtual int controlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength) = 0;
+        virtual TimeSource &getTimeSource();
+    };
+
+    struct EventTelemetry {
+        bool active;         // True if event telemetry is running
+        uint8_t mode;        // GPIO.4/EVTCNTR pin mode (see the values applicable to PinConfig/getPinConfig()/writePinConfig())
+        uint64_t total;      // Number of events counted since telemetry was started
+        uint64_t overflows;  // Number of 16-bit counter overflows that were accounted for
+        double rate;         // Event rate measured between the last two polls (in events per second)
+        double avgrate;      // Average event rate since telemetry was started (in events per second)
+    };
+
+    struct IdlePolicy {
+        double idle;         // Idle time (in s) after which the next control transfer is deemed a first transfer, and accounted for as such in TransferStats
+        double keepalive;    // Idle time (in s) after which a keepalive transfer is issued, so that the device and the host stay warm, or zero in order to disable keepalives
+        bool noautosuspend;  // True if USB autosuspend should be disabled whenever the device is opened (this requires write access to sysfs)
+
+        IdlePolicy();
+    };
+
+    struct OperationProfile {
+        uint64_t calls;         // Number of calls
+        uint64_t transfers;     // Number of control and bulk transfers issued during the calls
+        uint64_t bytes;         // Number of bytes sent and received during the calls (control data stage included)
+        LatencyStats cputime;   // Host CPU time statistics, as spent by the calling thread (in us)
+        LatencyStats walltime;  // Wall-clock time statistics (in us), which also include any time spent waiting on USB
+
+        OperationProfile();
+    };
+
+    // Per-operation profiler, used by this class and by GF1Device (added in version 1.3.0)
+    // Only the outermost profiled operation of each call chain is recorded, so that public functions calling one another are not counted twice
+    class Profiler
+    {
+    public:
+        // Measures a single operation, from construction to destruction
+        class Scope
+        {
+        private:
+            Profiler &profiler_;
+            const TimeSource &clock_;
+            const char *name_;
+            const Profiler *outer_;
+            const CP2130 *outerDevice_;
+            bool active_;
+            double cputime_;
+            std::chrono::steady_clock::time_point start_;
+            uint64_t transfers_, bytes_;
+
+        public:
+            Scope(Profiler &profiler, const CP2130 &device, const char *name);
+            ~Scope();
+        };
+
+    private:
+        std::atomic<bool> enabled_;
+        mutable std::mutex mutex_;
+        std::map<std::string, OperationProfile> profiles_;
+
+    public:
+        Profiler();
+
+        std::map<std::string, OperationProfile> getProfiles() const;
+        bool isEnabled() const;
+
+        void reset();
+        void setEnabled(bool enabled);
+    };
+
+    struct StreamResult {
+        size_t bytes;    // Number of payload bytes that were sent (or exchanged) in full, and that reached the SPI bus
+        bool cancelled;  // True if the stream was cancelled via cancel() before completion
+    };
+
+    struct TimingModel {
+        double ctrltime;  // Duration of a control transfer (in us)
+        double bulktime;  // Fixed duration of a bulk transfer (in us)
+        double bytetime;  // Additional duration of a bulk transfer, per byte (in us)
+    };
+
+    struct TransferStats {
+        uint64_t ctrltrfs;     // Number of control transfers
+        uint64_t bulktrfs;     // Number of bulk transfers
+        uint64_t bytesin;      // Number of bytes received from the device (control data stage included)
+        uint64_t bytesout;     // Number of bytes sent to the device (control data stage included)
+        uint64_t errors;       // Number of failed transfers
+        uint64_t allocs;       // Number of transfer buffer allocations
+        uint64_t devallocs;    // Number of transfer buffer allocations that were served from device memory (zero-copy), which are also counted above
+        uint64_t coalesced;    // Number of SPI writes that were merged into a preceding one (see setWriteCoalescing())
+        uint64_t keepalives;   // Number of keepalive transfers, which are also counted above (see setIdlePolicy())
+        LatencyStats ctrllat;  // Control transfer latency statistics
+        LatencyStats bulklat;  // Bulk transfer latency statistics
+        LatencyStats firstlat;   // Latency statistics of the control transfers issued after the device sat idle (first transfers, which are also counted in "ctrllat")
+        LatencyStats steadylat;  // Latency statistics of the remaining control transfers (steady-state transfers, keepalive transfers excluded)
+        EventTelemetry evttlm;  // Event counter telemetry, published alongside the transfer statistics
+
+        TransferStats();
+    };
+
+    struct WatchdogPolicy {
+        bool enabled;          // True if the watchdog is enabled
+        double alpha;          // Smoothing factor of the rolling baselines (between 0 and 1, the higher the faster these follow recent transfers)
+        double threshold;      // Number of standard deviations above the latency baseline beyond which a transfer is deemed anomalous
+        double floor;          // Latency ratio below which a transfer is never deemed anomalous, even if the baseline is very steady
+        uint32_t warmup;       // Number of transfers used to establish the baselines, before any anomalies are flagged
+        uint32_t consecutive;  // Number of consecutive anomalous transfers that trip the watchdog
+        double maxerrrate;     // Error rate (between 0 and 1) beyond which the watchdog trips
+        bool recover;          // True if the device should be recovered proactively once the watchdog trips (see GF1Device)
+        double cooldown;       // Minimum interval between proactive recoveries (in s)
+
+        WatchdogPolicy();
+    };
+
+    struct WatchdogStatus {
+        bool tripped;         // True if the watchdog tripped, until resetWatchdog() is called or the device is recovered
+        uint64_t samples;     // Number of transfers observed
+        uint64_t anomalies;   // Number of anomalous transfers
+        uint64_t trips;       // Number of times the watchdog tripped
+        uint64_t recoveries;  // Number of recoveries carried out via recover()
+        double baseline;      // Latency baseline, as a ratio to the duration predicted by the timing model
+        double deviation;     // Standard deviation of the latency ratio
+        double errrate;       // Error rate baseline (between 0 and 1)
+
+        WatchdogStatus();
+    };
+
 private:
     libusb_context *context_;
     libusb_device_handle *handle_;
+    uint8_t backend_;
+    int fd_;
+    Transport *transport_;
+    TimeSource *clock_;
     bool disconnected_, kernelWasAttached_;
-
+    bool gpioBatching_;
+    uint16_t gpioPendingValues_, gpioPendingMask_;
+    uint16_t wcChannels_;
+    uint8_t csSelected_, wcEndpoint_;
+    std::vector<uint8_t> wcPending_;
+    std::vector<unsigned char> buffer_;
+    unsigned char *devmem_;
+    size_t devmemSize_;
+    TransferStats stats_;
+    EventTelemetry evttlm_;
+    uint16_t evtLastValue_;
+    std::chrono::steady_clock::time_point evtStart_, evtLastPoll_;
+    TimingModel timing_;
+    double fitCount_, fitBytes_, fitTime_, fitBytesTime_, fitBytesSquared_;
+    bool trfBatching_;
+    usbdevfs_urb *urbs_;
+    std::vector<unsigned char> urbBuffers_;
+    size_t urbsPending_;
+    WatchdogPolicy wdpolicy_;
+    WatchdogStatus wdstatus_;
+    double wdVariance_;
+    uint32_t wdConsecutive_;
+    std::atomic<bool> cancelRequested_;
+    std::mutex streamMutex_;
+    libusb_transfer *streamTransfer_;
+    usbdevfs_urb *streamURB_;
+    Profiler profiler_;
+    IdlePolicy idlepolicy_;
+    std::chrono::steady_clock::time_point lastActivity_;
+    bool inKeepalive_;
+    mutable std::recursive_mutex ioMutex_;
+    std::mutex kaMutex_;
+    std::condition_variable kaCond_;
+    std::atomic<bool> kaQuit_;
+    std::thread kaThread_;
+
+    void profileTransfer(uint64_t bytes) const;
+    std::string sysfsPath() const;
+    std::string usbfsPath() const;
+
+    void applyIdlePolicy(int &errcnt, std::string &errstr);
     std::u16string getDescGeneric(uint8_t command, int &errcnt, std::string &errstr);
+    void releaseBuffer();
+    unsigned char *reserveBuffer(size_t size);
+    void runKeepalive();
+    void stopKeepalive();
+    int streamSegment(uint8_t endpointOutAddr, unsigned char *data, int length, int *transferred);
+    int usbfsBulkTransfer(uint8_t endpointAddr, unsigned char *data, int length, int *transferred);
+    int usbfsClaim();
+    void usbfsClose(bool release);
+    int usbfsControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength);
+    void usbfsDeferControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength, int &errcnt, std::string &errstr);
+    usbdevfs_urb *usbfsFillControlURB(size_t slot, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const unsigned char *data, uint16_t wLength);
+    int usbfsOpen();
+    usbdevfs_urb *usbfsReap(std::chrono::steady_clock::time_point deadline, int &result);
+    int usbfsTransfer(usbdevfs_urb *urb);
+    void watchdogSample(double latency, double expected, bool failed);
+    void writeCommand(const uint8_t *data, size_t size, uint8_t endpointOutAddr, int &errcnt, std::string &errstr);
     void writeDescGeneric(const std::u16string &descriptor, uint8_t command, int &errcnt, std::string &errstr);
 
+    static bool probeSerial(libusb_device *device, uint8_t index, std::string &serial);
+    static int receiveFD(int socket, uint8_t &flags);
+    static bool sendFD(int socket, int fd, uint8_t flags);
+    static void LIBUSB_CALL streamCallback(libusb_transfer *transfer);
+    static int usbfsResult(const usbdevfs_urb *urb);
+
 public:
     // Class definitions
     static const uint16_t VID = 0x10c4;    // Default USB vendor ID
@@ -47,6 +275,11 @@ public:
     static const int ERROR_NOT_FOUND = 2;  // Returned by open() if the device was not found
     static const int ERROR_BUSY = 3;       // Returned by open() if the device is already in use
 
+    // The following values are applicable to open()/getBackend() (added in version 1.3.0), except BACKEND_TRANSPORT, which only applies to getBackend()
+    static const uint8_t BACKEND_LIBUSB = 0x00;     // Transfers are carried out via libusb
+    static const uint8_t BACKEND_USBFS = 0x01;      // Transfers are carried out via direct URB submission to usbfs (Linux only)
+    static const uint8_t BACKEND_TRANSPORT = 0x02;  // Transfers are carried out via a user supplied transport (see openTransport())
+
     // Descriptor specific definitions
     static const size_t DESCMXL_MANUFACTURER = 62;  // Maximum length of manufacturer descriptor
     static const size_t DESCMXL_PRODUCT = 62;       // Maximum length of product descriptor
@@ -330,9 +563,29 @@ public:
     ~CP2130();
 
     bool disconnected() const;
+    double estimateControlTime() const;
+    double estimateSPIReadTime(uint32_t bytes, uint8_t cfrq) const;
+    double estimateSPIWriteTime(uint32_t bytes, uint8_t cfrq, const SPIDelays &delays) const;
+    double estimateSPIWriteTime(uint32_t bytes, uint8_t cfrq) const;
+    uint8_t getBackend() const;
+    EventTelemetry getEventTelemetry() const;
+    IdlePolicy getIdlePolicy() const;
+    std::map<std::string, OperationProfile> getOperationProfiles() const;
+    TimeSource &getTimeSource() const;
+    TimingModel getTimingModel() const;
+    TransferStats getTransferStats() const;
+    WatchdogPolicy getWatchdogPolicy() const;
+    WatchdogStatus getWatchdogStatus() const;
+    bool isAutosuspendEnabled(int &errcnt, std::string &errstr) const;
     bool isOpen() const;
+    bool isProfiling() const;
+    bool isWriteCoalescing(uint8_t channel) const;
 
+    void beginGPIOBatch();
+    void beginTransferBatch();
     void bulkTransfer(uint8_t endpointAddr, unsigned char *data, int length, int *transferred, int &errcnt, std::string &errstr);
+    void calibrateTimingModel();
+    void cancel();
     void close();
     void configureGPIO(uint8_t pin, uint8_t mode, bool value, int &errcnt, std::string &errstr);
     void configureSPIDelays(uint8_t channel, const SPIDelays &delays, int &errcnt, std::string &errstr);
@@ -341,6 +594,11 @@ public:
     void disableCS(uint8_t channel, int &errcnt, std::string &errstr);
     void disableSPIDelays(uint8_t channel, int &errcnt, std::string &errstr);
     void enableCS(uint8_t channel, int &errcnt, std::string &errstr);
+    void endGPIOBatch(int &errcnt, std::string &errstr);
+    void endTransferBatch(int &errcnt, std::string &errstr);
+    void flushGPIOs(int &errcnt, std::string &errstr);
+    void flushTransfers(int &errcnt, std::string &errstr);
+    void flushWrites(int &errcnt, std::string &errstr);
     uint8_t getClockDivider(int &errcnt, std::string &errstr);
     bool getCS(uint8_t channel, int &errcnt, std::string &errstr);
     uint8_t getEndpointInAddr(int &errcnt, std::string &errstr);
@@ -370,13 +628,22 @@ public:
     SPIMode getSPIMode(uint8_t channel, int &errcnt, std::string &errstr);
     uint8_t getTransferPriority(int &errcnt, std::string &errstr);
     USBConfig getUSBConfig(int &errcnt, std::string &errstr);
+    void handOff(int socket, int &errcnt, std::string &errstr);
     bool isOTPBlank(int &errcnt, std::string &errstr);
     bool isOTPLocked(int &errcnt, std::string &errstr);
     bool isRTRActive(int &errcnt, std::string &errstr);
     void lockOTP(int &errcnt, std::string &errstr);
-    int open(uint16_t vid, uint16_t pid, const std::string &serial = std::string());
+    int open(uint16_t vid, uint16_t pid, const std::string &serial = std::string(), uint8_t backend = BACKEND_LIBUSB);
+    int openFD(int fd, uint8_t backend = BACKEND_LIBUSB, bool kernelWasAttached = false);
+    int openTransport(Transport *transport);
+    EventTelemetry pollEventTelemetry(int &errcnt, std::string &errstr);
+    int recover(int &errcnt, std::string &errstr);
     void reset(int &errcnt, std::string &errstr);
+    void resetOperationProfiles();
+    void resetTransferStats();
+    void resetWatchdog();
     void selectCS(uint8_t channel, int &errcnt, std::string &errstr);
+    void setAutosuspend(bool enabled, int &errcnt, std::string &errstr);
     void setClockDivider(uint8_t value, int &errcnt, std::string &errstr);
     void setEventCounter(const EventCounter &evcntr, int &errcnt, std::string &errstr);
     void setFIFOThreshold(uint8_t threshold, int &errcnt, std::string &errstr);
@@ -392,13 +659,23 @@ public:
     void setGPIO9(bool value, int &errcnt, std::string &errstr);
     void setGPIO10(bool value, int &errcnt, std::string &errstr);
     void setGPIOs(uint16_t bmValues, uint16_t bmMask, int &errcnt, std::string &errstr);
+    void setIdlePolicy(const IdlePolicy &policy, int &errcnt, std::string &errstr);
+    void setProfiling(bool enabled);
+    void setTimingModel(const TimingModel &model);
+    void setWatchdogPolicy(const WatchdogPolicy &policy);
+    void setWriteCoalescing(uint8_t channel, bool enabled, int &errcnt, std::string &errstr);
     std::vector<uint8_t> spiRead(uint32_t bytesToRead, uint8_t endpointInAddr, uint8_t endpointOutAddr, int &errcnt, std::string &errstr);
     std::vector<uint8_t> spiRead(uint32_t bytesToRead, int &errcnt, std::string &errstr);
     void spiWrite(const std::vector<uint8_t> &data, uint8_t endpointOutAddr, int &errcnt, std::string &errstr);
     void spiWrite(const std::vector<uint8_t> &data, int &errcnt, std::string &errstr);
     std::vector<uint8_t> spiWriteRead(const std::vector<uint8_t> &data, uint8_t endpointInAddr, uint8_t endpointOutAddr, int &errcnt, std::string &errstr);
     std::vector<uint8_t> spiWriteRead(const std::vector<uint8_t> &data, int &errcnt, std::string &errstr);
+    std::vector<uint8_t> spiWriteReadStream(const std::vector<uint8_t> &data, uint8_t endpointInAddr, uint8_t endpointOutAddr, StreamResult &result, int &errcnt, std::string &errstr);
+    StreamResult spiWriteStream(const std::vector<uint8_t> &data, uint8_t endpointOutAddr, size_t segmentSize, int &errcnt, std::string &errstr);
+    void startEventTelemetry(uint8_t mode, int &errcnt, std::string &errstr);
+    void stopEventTelemetry();
     void stopRTR(int &errcnt, std::string &errstr);
+    int takeOver(int socket, uint8_t backend = BACKEND_LIBUSB);
     void writeLockWord(uint16_t word, int &errcnt, std::string &errstr);
     void writeManufacturerDesc(const std::u16string &manufacturer, int &errcnt, std::string &errstr);
     void writePinConfig(const PinConfig &config, int &errcnt, std::string &errstr);
@@ -408,6 +685,7 @@ public:
     void writeUSBConfig(const USBConfig &config, uint8_t mask, int &errcnt, std::string &errstr);
 
     static std::list<std::string> listDevices(uint16_t vid, uint16_t pid, int &errcnt, std::string &errstr);
+    static double spiClockFrequency(uint8_t cfrq);
 };
 
 #endif  // CP2130_H
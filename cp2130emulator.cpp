@@ -0,0 +1,622 @@
+/* CP2130 emulator class - Version 1.0.0
+   Requires CP2130 class version 1.3.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <algorithm>
+#include <cstring>
+#include "cp2130emulator.h"
+
+// Definitions
+const uint8_t ROVER_MAJ = 0x01;  // Major read-only version reported by the emulator
+const uint8_t ROVER_MIN = 0x10;  // Minor read-only version reported by the emulator
+
+// Descriptor tables, indexed by the Get/Set_Manufacturing_String_1 [0x62/0x63] to Get/Set_Serial_String [0x6a/0x6b] commands (divided by two)
+const size_t DESC_INDEXES[5] = {  // OTP ROM field indexes
+    CP2130::PROMIDX_MANUFACTURING_STRING_1, CP2130::PROMIDX_MANUFACTURING_STRING_2, CP2130::PROMIDX_PRODUCT_STRING_1, CP2130::PROMIDX_PRODUCT_STRING_2, CP2130::PROMIDX_SERIAL_STRING
+};
+const size_t DESC_SIZES[5] = {  // OTP ROM field sizes
+    CP2130::PROMSZE_MANUFACTURING_STRING_1, CP2130::PROMSZE_MANUFACTURING_STRING_2, CP2130::PROMSZE_PRODUCT_STRING_1, CP2130::PROMSZE_PRODUCT_STRING_2, CP2130::PROMSZE_SERIAL_STRING
+};
+const uint16_t DESC_LOCKBITS[5] = {  // Corresponding lock bits
+    0x0020, 0x0040, 0x0100, 0x0200, CP2130::LWSER
+};
+
+// Masks applicable to the write mask of the Set_USB_Config command, each one corresponding to the lock bit of the same field
+const uint8_t UCVID = 0x01;      // VID
+const uint8_t UCPID = 0x02;      // PID
+const uint8_t UCMAXPOW = 0x04;   // Maximum power consumption
+const uint8_t UCPOWMODE = 0x08;  // Power mode
+const uint8_t UCREL = 0x10;      // Release version
+const uint8_t UCTRFPRIO = 0x80;  // Transfer priority
+
+// Private procedure that counts an event on the GPIO.4/EVTCNTR pin, according to the event counter mode and to the previous and current levels of the pin
+// Note that a negative pulse is counted when it ends (rising edge), and a positive pulse is likewise counted when it ends (falling edge)
+void CP2130Emulator::countEvent(bool previous, bool current)
+{
+    bool rising = !previous && current;
+    bool falling = previous && !current;
+    if (((evtMode_ == CP2130::PCEVTCNTRRE || evtMode_ == CP2130::PCEVTCNTRNP) && rising) || ((evtMode_ == CP2130::PCEVTCNTRFE || evtMode_ == CP2130::PCEVTCNTRPP) && falling)) {
+        ++evtValue_;
+        if (evtValue_ == 0x0000) {  // The counter wrapped around
+            evtOverflow_ = true;
+        }
+    }
+}
+
+// Private procedure that enables the chip selects in the given bitmap (one bit per channel), and disables all others, notifying the affected SPI slaves
+void CP2130Emulator::setChipSelects(uint16_t enabled)
+{
+    for (uint8_t channel = 0; channel < 11; ++channel) {
+        bool previous = (0x0001 << channel & csEnabled_) != 0x0000;
+        bool current = (0x0001 << channel & enabled) != 0x0000;
+        if (slaves_[channel] != nullptr && previous != current) {
+            slaves_[channel]->select(current);
+        }
+    }
+    csEnabled_ = enabled;
+}
+
+// Private procedure that sets the levels of the GPIO pins, notifying every attached SPI slave
+void CP2130Emulator::setGPIOs(uint16_t values)
+{
+    uint16_t previous = gpioValues_;
+    gpioValues_ = static_cast<uint16_t>(CP2130::BMGPIOS & values);
+    if (gpioModes_[4] >= CP2130::PCEVTCNTRRE) {  // GPIO.4 is configured as an event counter input
+        countEvent((CP2130::BMGPIO4 & previous) != 0x0000, (CP2130::BMGPIO4 & gpioValues_) != 0x0000);
+    }
+    if (gpioValues_ != previous) {
+        for (uint8_t channel = 0; channel < 11; ++channel) {
+            if (slaves_[channel] != nullptr) {
+                slaves_[channel]->gpio(gpioValues_);
+            }
+        }
+    }
+}
+
+// Private function that clocks one byte through the SPI bus, returning the byte received from the selected SPI slaves
+// If no slave is selected, MISO is assumed to be held low
+uint8_t CP2130Emulator::transferSPI(uint8_t mosi)
+{
+    uint8_t miso = 0x00;
+    for (uint8_t channel = 0; channel < 11; ++channel) {
+        if (slaves_[channel] != nullptr && (0x0001 << channel & csEnabled_) != 0x0000) {
+            miso = static_cast<uint8_t>(miso | slaves_[channel]->transfer(mosi));
+        }
+    }
+    return miso;
+}
+
+// Private procedure that writes a USB string descriptor to the given OTP ROM field, bypassing the lock bits
+void CP2130Emulator::writeDescGeneric(const std::u16string &descriptor, size_t index, size_t size)
+{
+    std::vector<uint8_t> field(size, 0x00);
+    field[0] = static_cast<uint8_t>(std::min(2 * descriptor.size() + 2, size));  // USB string descriptor length
+    field[1] = 0x03;                                                            // USB string descriptor constant
+    for (size_t i = 2; i < size && (i - 2) / 2 < descriptor.size(); ++i) {
+        field[i] = static_cast<uint8_t>(descriptor[(i - 2) / 2] >> (i % 2 == 0 ? 0 : 8));  // UTF-16LE conversion as per the USB 2.0 specification
+    }
+    std::memcpy(prom_ + index, field.data(), size);
+}
+
+// Private function that writes to the given OTP ROM field, as long as the given lock bits are set (i.e., the field is not locked)
+// Returns true if the field was written, or false otherwise
+bool CP2130Emulator::writePROM(size_t index, const unsigned char *data, size_t size, uint16_t lockbits)
+{
+    uint16_t lockword = static_cast<uint16_t>(prom_[CP2130::PROMIDX_LOCK_BYTE + 1] << 8 | prom_[CP2130::PROMIDX_LOCK_BYTE]);
+    bool unlocked = (lockbits & lockword) == lockbits;
+    if (unlocked) {
+        std::memcpy(prom_ + index, data, size);
+    }
+    return unlocked;
+}
+
+// Destructor for SPISlave
+CP2130Emulator::SPISlave::~SPISlave()
+{
+}
+
+// Notifies the SPI slave of the levels of the GPIO pins, whenever these change (does nothing by default)
+void CP2130Emulator::SPISlave::gpio(uint16_t)
+{
+}
+
+// Sets the clock followed by the SPI slave, which is the clock of the emulated device it is attached to (does nothing by default)
+void CP2130Emulator::SPISlave::setTimeSource(const TimeSource &)
+{
+}
+
+// The emulated device starts with a blank OTP ROM, apart from the given VID and PID, a transfer priority set to high priority write, and a pin configuration having GPIO.0 and GPIO.1 as chip selects
+CP2130Emulator::CP2130Emulator(uint16_t vid, uint16_t pid) :
+    slaves_(),
+    prom_(),
+    gpioValues_(CP2130::BMGPIOS),
+    csEnabled_(0x0000),
+    gpioModes_(),
+    spiWords_(),
+    spiDelays_(),
+    clockDivider_(0x00),
+    fifoThreshold_(0x00),
+    evtMode_(0x00),
+    evtValue_(0x0000),
+    evtOverflow_(false),
+    header_(),
+    headerLength_(0),
+    command_(0x00),
+    remaining_(0),
+    response_(),
+    responses_(),
+    clock_()
+{
+    std::fill(prom_, prom_ + CP2130::PROM_SIZE, 0xff);
+    writeUSBConfig({vid, pid, 0x01, 0x00, 0x32, CP2130::PMBUSREGEN, CP2130::PRIOWRITE});
+    writePinConfig({CP2130::PCCS, CP2130::PCCS, CP2130::PCOUTPP, CP2130::PCOUTPP, CP2130::PCIN, CP2130::PCIN, CP2130::PCIN, CP2130::PCIN, CP2130::PCIN, CP2130::PCIN, CP2130::PCIN, 0x0000, 0x0000, 0x0000, 0x0000, 0x00});
+    writeManufacturerDesc(std::u16string());
+    writeProductDesc(std::u16string());
+    writeSerialDesc(std::u16string());
+    reset();
+}
+
+// Returns the chip select bitmap, having one bit per channel
+uint16_t CP2130Emulator::getCS() const
+{
+    return csEnabled_;
+}
+
+// Returns the levels of the GPIO pins, in bitmap format (see the values applicable to CP2130::getGPIOs()/CP2130::setGPIOs())
+uint16_t CP2130Emulator::getGPIOs() const
+{
+    return gpioValues_;
+}
+
+// Checks if there is data to be sent to the host via the bulk IN endpoint
+bool CP2130Emulator::hasResponse() const
+{
+    return !responses_.empty();
+}
+
+// Checks if a vendor request, having the given parameters, is valid, so that it can be stalled before its data stage otherwise
+// Requests that are not used by the CP2130 class are reported as invalid
+bool CP2130Emulator::isValidRequest(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wLength) const
+{
+    bool valid;
+    if (bmRequestType == CP2130::GET) {
+        switch (bRequest) {
+            case CP2130::GET_READONLY_VERSION:
+            case CP2130::GET_GPIO_VALUES:
+            case CP2130::GET_GPIO_CHIP_SELECT:
+            case CP2130::GET_SPI_WORD:
+            case CP2130::GET_SPI_DELAY:
+            case CP2130::GET_FULL_THRESHOLD:
+            case CP2130::GET_RTR_STATE:
+            case CP2130::GET_EVENT_COUNTER:
+            case CP2130::GET_CLOCK_DIVIDER:
+            case CP2130::GET_USB_CONFIG:
+            case CP2130::GET_MANUFACTURING_STRING_1:
+            case CP2130::GET_MANUFACTURING_STRING_2:
+            case CP2130::GET_PRODUCT_STRING_1:
+            case CP2130::GET_PRODUCT_STRING_2:
+            case CP2130::GET_SERIAL_STRING:
+            case CP2130::GET_PIN_CONFIG:
+            case CP2130::GET_LOCK_BYTE:
+            case CP2130::GET_PROM_CONFIG:
+                valid = true;
+                break;
+            default:
+                valid = false;
+        }
+    } else if (bmRequestType == CP2130::SET) {
+        switch (bRequest) {
+            case CP2130::RESET_DEVICE:
+                valid = wLength == CP2130::RESET_DEVICE_WLEN;
+                break;
+            case CP2130::SET_GPIO_VALUES:
+                valid = wLength == CP2130::SET_GPIO_VALUES_WLEN;
+                break;
+            case CP2130::SET_GPIO_MODE_AND_LEVEL:
+                valid = wLength == CP2130::SET_GPIO_MODE_AND_LEVEL_WLEN;
+                break;
+            case CP2130::SET_GPIO_CHIP_SELECT:
+                valid = wLength == CP2130::SET_GPIO_CHIP_SELECT_WLEN;
+                break;
+            case CP2130::SET_SPI_WORD:
+                valid = wLength == CP2130::SET_SPI_WORD_WLEN;
+                break;
+            case CP2130::SET_SPI_DELAY:
+                valid = wLength == CP2130::SET_SPI_DELAY_WLEN;
+                break;
+            case CP2130::SET_FULL_THRESHOLD:
+                valid = wLength == CP2130::SET_FULL_THRESHOLD_WLEN;
+                break;
+            case CP2130::SET_RTR_STOP:
+                valid = wLength == CP2130::SET_RTR_STOP_WLEN;
+                break;
+            case CP2130::SET_EVENT_COUNTER:
+                valid = wLength == CP2130::SET_EVENT_COUNTER_WLEN;
+                break;
+            case CP2130::SET_CLOCK_DIVIDER:
+                valid = wLength == CP2130::SET_CLOCK_DIVIDER_WLEN;
+                break;
+            case CP2130::SET_USB_CONFIG:
+                valid = wValue == CP2130::PROM_WRITE_KEY && wLength == CP2130::SET_USB_CONFIG_WLEN;  // Writes to the OTP ROM require the write key
+                break;
+            case CP2130::SET_MANUFACTURING_STRING_1:
+            case CP2130::SET_MANUFACTURING_STRING_2:
+            case CP2130::SET_PRODUCT_STRING_1:
+            case CP2130::SET_PRODUCT_STRING_2:
+            case CP2130::SET_SERIAL_STRING:
+            case CP2130::SET_PROM_CONFIG:
+                valid = wValue == CP2130::PROM_WRITE_KEY && wLength == CP2130::SET_PROM_CONFIG_WLEN;
+                break;
+            case CP2130::SET_PIN_CONFIG:
+                valid = wValue == CP2130::PROM_WRITE_KEY && wLength == CP2130::SET_PIN_CONFIG_WLEN;
+                break;
+            case CP2130::SET_LOCK_BYTE:
+                valid = wValue == CP2130::PROM_WRITE_KEY && wLength == CP2130::SET_LOCK_BYTE_WLEN;
+                break;
+            default:
+                valid = false;
+        }
+    } else {
+        valid = false;
+    }
+    return valid;
+}
+
+// Attaches an SPI slave to the given channel, or detaches any slave if a null pointer is passed
+// The slave is not owned by the emulator, and must outlive it (or be detached beforehand)
+void CP2130Emulator::attach(uint8_t channel, SPISlave *slave)
+{
+    if (channel < 11) {
+        slaves_[channel] = slave;
+        if (slave != nullptr) {
+            slave->setTimeSource(clock_);  // The slave follows the clock of the emulated device
+            slave->gpio(gpioValues_);  // Synchronize the slave with the current levels of the GPIO pins
+        }
+    }
+}
+
+// Processes data received via the bulk OUT endpoint, which may contain any number of commands, or parts of them
+// Responses to ReadWithRTR, Read and WriteRead commands are queued, one per command, and can be retrieved via popResponse()
+void CP2130Emulator::bulkOut(const unsigned char *data, size_t length)
+{
+    size_t i = 0;
+    while (i < length) {
+        if (headerLength_ < 8) {  // Command header
+            header_[headerLength_] = data[i];
+            ++headerLength_;
+            ++i;
+            if (headerLength_ == 8) {
+                command_ = header_[2];
+                remaining_ = static_cast<uint32_t>(header_[7] << 24 | header_[6] << 16 | header_[5] << 8 | header_[4]);  // Length (little-endian conversion)
+                if (command_ == CP2130::READ || command_ == CP2130::READWITHRTR) {  // Note that RTR is never deasserted by the emulator
+                    std::vector<uint8_t> response(remaining_);
+                    for (uint32_t j = 0; j < remaining_; ++j) {
+                        response[j] = transferSPI(0x00);
+                    }
+                    responses_.push_back(response);
+                    remaining_ = 0;
+                } else if (command_ != CP2130::WRITE && command_ != CP2130::WRITEREAD) {  // Unknown commands are discarded
+                    remaining_ = 0;
+                }
+                if (remaining_ == 0) {
+                    headerLength_ = 0;
+                }
+            }
+        } else {  // Payload of a Write or WriteRead command
+            uint8_t miso = transferSPI(data[i]);
+            ++i;
+            if (command_ == CP2130::WRITEREAD) {
+                response_.push_back(miso);
+            }
+            --remaining_;
+            if (remaining_ == 0) {
+                if (command_ == CP2130::WRITEREAD) {
+                    responses_.push_back(response_);
+                    response_.clear();
+                }
+                headerLength_ = 0;
+            }
+        }
+    }
+}
+
+// Handles a device-to-host vendor request, returning the length of the data stage, or -1 if the request is to be stalled
+int CP2130Emulator::controlIn(uint8_t bRequest, uint16_t, uint16_t wIndex, unsigned char *data, uint16_t wLength)
+{
+    std::vector<uint8_t> reply;
+    switch (bRequest) {
+        case CP2130::GET_READONLY_VERSION:
+            reply = {ROVER_MAJ, ROVER_MIN};
+            break;
+        case CP2130::GET_GPIO_VALUES:
+            reply = {static_cast<uint8_t>(gpioValues_ >> 8), static_cast<uint8_t>(gpioValues_)};  // Big-endian bitmap
+            break;
+        case CP2130::GET_GPIO_CHIP_SELECT:
+            reply = {
+                static_cast<uint8_t>(csEnabled_ >> 8), static_cast<uint8_t>(csEnabled_),  // Channel chip select enable bitmap
+                static_cast<uint8_t>(csEnabled_ >> 8), static_cast<uint8_t>(csEnabled_)   // Pin chip select enable bitmap
+            };
+            break;
+        case CP2130::GET_SPI_WORD:
+            reply.assign(spiWords_, spiWords_ + 11);
+            break;
+        case CP2130::GET_SPI_DELAY:
+            if (wIndex < 11) {
+                reply.assign(spiDelays_[wIndex], spiDelays_[wIndex] + CP2130::GET_SPI_DELAY_WLEN);
+            }
+            break;
+        case CP2130::GET_FULL_THRESHOLD:
+            reply = {fifoThreshold_};
+            break;
+        case CP2130::GET_RTR_STATE:
+            reply = {0x00};  // ReadWithRTR commands are always completed immediately
+            break;
+        case CP2130::GET_EVENT_COUNTER:
+            reply = {static_cast<uint8_t>((evtOverflow_ ? 0x80 : 0x00) | evtMode_), static_cast<uint8_t>(evtValue_ >> 8), static_cast<uint8_t>(evtValue_)};
+            break;
+        case CP2130::GET_CLOCK_DIVIDER:
+            reply = {clockDivider_};
+            break;
+        case CP2130::GET_USB_CONFIG:
+            reply.assign(prom_, prom_ + CP2130::GET_USB_CONFIG_WLEN);  // The USB configuration is stored in the OTP ROM in the same format
+            break;
+        case CP2130::GET_MANUFACTURING_STRING_1:
+        case CP2130::GET_MANUFACTURING_STRING_2:
+        case CP2130::GET_PRODUCT_STRING_1:
+        case CP2130::GET_PRODUCT_STRING_2:
+        case CP2130::GET_SERIAL_STRING:
+            {
+                size_t table = (bRequest - CP2130::GET_MANUFACTURING_STRING_1) / 2;
+                reply.assign(prom_ + DESC_INDEXES[table], prom_ + DESC_INDEXES[table] + DESC_SIZES[table]);
+                reply.resize(CP2130::GET_SERIAL_STRING_WLEN, 0x00);  // Every table is 64 bytes long
+            }
+            break;
+        case CP2130::GET_PIN_CONFIG:
+            reply.assign(prom_ + CP2130::PROMIDX_PIN_CONFIG, prom_ + CP2130::PROMIDX_PIN_CONFIG + CP2130::PROMSZE_PIN_CONFIG);
+            break;
+        case CP2130::GET_LOCK_BYTE:
+            reply.assign(prom_ + CP2130::PROMIDX_LOCK_BYTE, prom_ + CP2130::PROMIDX_LOCK_BYTE + CP2130::PROMSZE_LOCK_BYTE);
+            break;
+        case CP2130::GET_PROM_CONFIG:
+            if (wIndex < CP2130::PROM_BLOCKS) {
+                reply.assign(prom_ + wIndex * CP2130::PROM_BLOCK_SIZE, prom_ + (wIndex + 1) * CP2130::PROM_BLOCK_SIZE);
+            }
+            break;
+    }
+    int retval;
+    if (reply.empty()) {
+        retval = -1;
+    } else {
+        retval = static_cast<int>(std::min(reply.size(), static_cast<size_t>(wLength)));
+        std::memcpy(data, reply.data(), static_cast<size_t>(retval));
+    }
+    return retval;
+}
+
+// Handles a host-to-device vendor request, returning false if the request is to be stalled
+// Note that the request should be validated via isValidRequest() beforehand, since the data stage cannot be stalled once received
+bool CP2130Emulator::controlOut(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const unsigned char *data, uint16_t wLength)
+{
+    bool accepted = isValidRequest(CP2130::SET, bRequest, wValue, wLength);
+    if (accepted) {
+        switch (bRequest) {
+            case CP2130::RESET_DEVICE:
+                reset();  // Note that the emulated device does not re-enumerate
+                break;
+            case CP2130::SET_GPIO_VALUES:
+                {
+                    uint16_t values = static_cast<uint16_t>(data[0] << 8 | data[1]);
+                    uint16_t mask = static_cast<uint16_t>(data[2] << 8 | data[3]);
+                    for (uint8_t pin = 0; pin < 11; ++pin) {  // Only pins configured as outputs are affected
+                        if (gpioModes_[pin] != CP2130::PCOUTOD && gpioModes_[pin] != CP2130::PCOUTPP) {
+                            mask = static_cast<uint16_t>(mask & ~(pin < 6 ? CP2130::BMGPIO0 << pin : CP2130::BMGPIO6 << (pin - 6)));
+                        }
+                    }
+                    setGPIOs(static_cast<uint16_t>((~mask & gpioValues_) | (mask & values)));
+                }
+                break;
+            case CP2130::SET_GPIO_MODE_AND_LEVEL:
+                if (data[0] > 10) {
+                    accepted = false;
+                } else {
+                    uint16_t bitmap = static_cast<uint16_t>(data[0] < 6 ? CP2130::BMGPIO0 << data[0] : CP2130::BMGPIO6 << (data[0] - 6));
+                    gpioModes_[data[0]] = data[1];
+                    if (data[1] == CP2130::PCOUTOD || data[1] == CP2130::PCOUTPP) {
+                        setGPIOs(static_cast<uint16_t>(data[2] != 0x00 ? gpioValues_ | bitmap : gpioValues_ & ~bitmap));
+                    }
+                }
+                break;
+            case CP2130::SET_GPIO_CHIP_SELECT:
+                if (data[0] > 10 || data[1] > 0x02) {
+                    accepted = false;
+                } else if (data[1] == 0x00) {  // Disable the chip select of the given channel
+                    setChipSelects(static_cast<uint16_t>(csEnabled_ & ~(0x0001 << data[0])));
+                } else if (data[1] == 0x01) {  // Enable the chip select of the given channel
+                    setChipSelects(static_cast<uint16_t>(csEnabled_ | 0x0001 << data[0]));
+                } else {  // Enable the chip select of the given channel, and disable all others
+                    setChipSelects(static_cast<uint16_t>(0x0001 << data[0]));
+                }
+                break;
+            case CP2130::SET_SPI_WORD:
+                if (data[0] > 10) {
+                    accepted = false;
+                } else {
+                    spiWords_[data[0]] = data[1];
+                }
+                break;
+            case CP2130::SET_SPI_DELAY:
+                if (data[0] > 10) {
+                    accepted = false;
+                } else {
+                    std::memcpy(spiDelays_[data[0]], data, CP2130::SET_SPI_DELAY_WLEN);
+                }
+                break;
+            case CP2130::SET_FULL_THRESHOLD:
+                fifoThreshold_ = data[0];
+                break;
+            case CP2130::SET_EVENT_COUNTER:
+                evtMode_ = static_cast<uint8_t>(0x07 & data[0]);
+                evtValue_ = static_cast<uint16_t>(data[1] << 8 | data[2]);
+                evtOverflow_ = false;
+                break;
+            case CP2130::SET_CLOCK_DIVIDER:
+                clockDivider_ = data[0];
+                break;
+            case CP2130::SET_USB_CONFIG:  // Each field is written if selected by the write mask, and if not locked
+                if ((UCVID & data[9]) != 0x00) {
+                    writePROM(CP2130::PROMIDX_VID, data, CP2130::PROMSZE_VID, CP2130::LWVID);
+                }
+                if ((UCPID & data[9]) != 0x00) {
+                    writePROM(CP2130::PROMIDX_PID, data + 2, CP2130::PROMSZE_PID, CP2130::LWPID);
+                }
+                if ((UCMAXPOW & data[9]) != 0x00) {
+                    writePROM(CP2130::PROMIDX_MAX_POWER, data + 4, CP2130::PROMSZE_MAX_POWER, CP2130::LWMAXPOW);
+                }
+                if ((UCPOWMODE & data[9]) != 0x00) {
+                    writePROM(CP2130::PROMIDX_POWER_MODE, data + 5, CP2130::PROMSZE_POWER_MODE, CP2130::LWPOWMODE);
+                }
+                if ((UCREL & data[9]) != 0x00) {
+                    writePROM(CP2130::PROMIDX_RELEASE_VERSION, data + 6, CP2130::PROMSZE_RELEASE_VERSION, CP2130::LWREL);
+                }
+                if ((UCTRFPRIO & data[9]) != 0x00) {
+                    writePROM(CP2130::PROMIDX_TRANSFER_PRIORITY, data + 8, CP2130::PROMSZE_TRANSFER_PRIORITY, CP2130::LWTRFPRIO);
+                }
+                break;
+            case CP2130::SET_MANUFACTURING_STRING_1:
+            case CP2130::SET_MANUFACTURING_STRING_2:
+            case CP2130::SET_PRODUCT_STRING_1:
+            case CP2130::SET_PRODUCT_STRING_2:
+            case CP2130::SET_SERIAL_STRING:
+                {
+                    size_t table = (bRequest - CP2130::SET_MANUFACTURING_STRING_1) / 2;
+                    writePROM(DESC_INDEXES[table], data, DESC_SIZES[table], DESC_LOCKBITS[table]);
+                }
+                break;
+            case CP2130::SET_PIN_CONFIG:
+                writePROM(CP2130::PROMIDX_PIN_CONFIG, data, CP2130::PROMSZE_PIN_CONFIG, CP2130::LWPINCFG);
+                break;
+            case CP2130::SET_LOCK_BYTE:
+                prom_[CP2130::PROMIDX_LOCK_BYTE] = static_cast<uint8_t>(prom_[CP2130::PROMIDX_LOCK_BYTE] & data[0]);  // Lock bits can only be cleared
+                prom_[CP2130::PROMIDX_LOCK_BYTE + 1] = static_cast<uint8_t>(prom_[CP2130::PROMIDX_LOCK_BYTE + 1] & data[1]);
+                break;
+            case CP2130::SET_PROM_CONFIG:
+                if (wIndex >= CP2130::PROM_BLOCKS) {
+                    accepted = false;
+                } else {
+                    std::memcpy(prom_ + wIndex * CP2130::PROM_BLOCK_SIZE, data, CP2130::PROM_BLOCK_SIZE);
+                }
+                break;
+        }
+    }
+    return accepted;
+}
+
+// Returns the clock of the emulated device, which follows real time unless made virtual (see TimeSource::setVirtual()), and is followed by the attached SPI slaves and by EmulatorTransport
+TimeSource &CP2130Emulator::getTimeSource()
+{
+    return clock_;
+}
+
+// Retrieves the oldest response to be sent to the host via the bulk IN endpoint, or an empty vector if there is none
+std::vector<uint8_t> CP2130Emulator::popResponse()
+{
+    std::vector<uint8_t> response;
+    if (!responses_.empty()) {
+        response.swap(responses_.front());
+        responses_.pop_front();
+    }
+    return response;
+}
+
+// Resets the emulated device to its power-on state, as set by the pin configuration in the OTP ROM
+void CP2130Emulator::reset()
+{
+    for (uint8_t pin = 0; pin < 11; ++pin) {
+        gpioModes_[pin] = prom_[CP2130::PROMIDX_PIN_CONFIG + pin];
+        spiWords_[pin] = 0x00;
+        std::fill(spiDelays_[pin], spiDelays_[pin] + CP2130::GET_SPI_DELAY_WLEN, 0x00);
+        spiDelays_[pin][0] = pin;
+    }
+    setChipSelects(0x0000);
+    setGPIOs(CP2130::BMGPIOS);  // Every pin is pulled high
+    clockDivider_ = prom_[CP2130::PROMIDX_PIN_CONFIG + CP2130::PROMSZE_PIN_CONFIG - 1];
+    fifoThreshold_ = 0x00;
+    evtMode_ = 0x00;
+    evtValue_ = 0x0000;
+    evtOverflow_ = false;
+    headerLength_ = 0;
+    remaining_ = 0;
+    response_.clear();
+    responses_.clear();
+}
+
+// Sets the levels of the given GPIO pins, as if these were driven externally (e.g., by a trigger source)
+void CP2130Emulator::setInputs(uint16_t values, uint16_t mask)
+{
+    setGPIOs(static_cast<uint16_t>((~mask & gpioValues_) | (mask & values)));
+}
+
+// Writes the manufacturer descriptor to the emulated OTP ROM, bypassing the lock bits
+void CP2130Emulator::writeManufacturerDesc(const std::u16string &manufacturer)
+{
+    writeDescGeneric(manufacturer, CP2130::PROMIDX_MANUFACTURING_STRING_1, CP2130::PROMSZE_MANUFACTURING_STRING_1 + CP2130::PROMSZE_MANUFACTURING_STRING_2);  // Both tables are contiguous
+}
+
+// Writes the pin configuration to the emulated OTP ROM, bypassing the lock bits
+void CP2130Emulator::writePinConfig(const CP2130::PinConfig &config)
+{
+    uint8_t field[CP2130::PROMSZE_PIN_CONFIG] = {
+        config.gpio0, config.gpio1, config.gpio2, config.gpio3, config.gpio4, config.gpio5, config.gpio6, config.gpio7, config.gpio8, config.gpio9, config.gpio10,
+        static_cast<uint8_t>(config.sspndlvl >> 8), static_cast<uint8_t>(config.sspndlvl),
+        static_cast<uint8_t>(config.sspndmode >> 8), static_cast<uint8_t>(config.sspndmode),
+        static_cast<uint8_t>(config.wkupmask >> 8), static_cast<uint8_t>(config.wkupmask),
+        static_cast<uint8_t>(config.wkupmatch >> 8), static_cast<uint8_t>(config.wkupmatch),
+        config.divider
+    };
+    std::memcpy(prom_ + CP2130::PROMIDX_PIN_CONFIG, field, CP2130::PROMSZE_PIN_CONFIG);
+}
+
+// Writes the product descriptor to the emulated OTP ROM, bypassing the lock bits
+void CP2130Emulator::writeProductDesc(const std::u16string &product)
+{
+    writeDescGeneric(product, CP2130::PROMIDX_PRODUCT_STRING_1, CP2130::PROMSZE_PRODUCT_STRING_1 + CP2130::PROMSZE_PRODUCT_STRING_2);  // Both tables are contiguous
+}
+
+// Writes the serial descriptor to the emulated OTP ROM, bypassing the lock bits
+void CP2130Emulator::writeSerialDesc(const std::u16string &serial)
+{
+    writeDescGeneric(serial, CP2130::PROMIDX_SERIAL_STRING, CP2130::PROMSZE_SERIAL_STRING);
+}
+
+// Writes the USB configuration to the emulated OTP ROM, bypassing the lock bits
+// The fields are stored in the same format used by the Get_USB_Config command
+void CP2130Emulator::writeUSBConfig(const CP2130::USBConfig &config)
+{
+    uint8_t field[CP2130::GET_USB_CONFIG_WLEN] = {
+        static_cast<uint8_t>(config.vid), static_cast<uint8_t>(config.vid >> 8),  // VID
+        static_cast<uint8_t>(config.pid), static_cast<uint8_t>(config.pid >> 8),  // PID
+        config.maxpow,                                                            // Maximum consumption current
+        config.powmode,                                                           // Power mode
+        config.majrel, config.minrel,                                             // Major and minor release versions
+        config.trfprio                                                            // Transfer priority
+    };
+    std::memcpy(prom_, field, CP2130::GET_USB_CONFIG_WLEN);
+}
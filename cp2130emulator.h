@@ -0,0 +1,97 @@
+/* CP2130 emulator class - Version 1.0.0
+   Requires CP2130 class version 1.3.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef CP2130EMULATOR_H
+#define CP2130EMULATOR_H
+
+// Includes
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include "cp2130.h"
+#include "timesource.h"
+
+class CP2130Emulator
+{
+public:
+    // Interface implemented by the emulated devices that are attached to the SPI bus
+    class SPISlave
+    {
+    public:
+        virtual ~SPISlave();
+
+        virtual void gpio(uint16_t values);
+        virtual void select(bool selected) = 0;
+        virtual void setTimeSource(const TimeSource &clock);
+        virtual uint8_t transfer(uint8_t mosi) = 0;
+    };
+
+private:
+    SPISlave *slaves_[11];
+    uint8_t prom_[CP2130::PROM_SIZE];
+    uint16_t gpioValues_, csEnabled_;
+    uint8_t gpioModes_[11];
+    uint8_t spiWords_[11];
+    uint8_t spiDelays_[11][CP2130::GET_SPI_DELAY_WLEN];
+    uint8_t clockDivider_, fifoThreshold_;
+    uint8_t evtMode_;
+    uint16_t evtValue_;
+    bool evtOverflow_;
+    uint8_t header_[8];
+    size_t headerLength_;
+    uint8_t command_;
+    uint32_t remaining_;
+    std::vector<uint8_t> response_;
+    std::deque<std::vector<uint8_t>> responses_;
+    TimeSource clock_;
+
+    void countEvent(bool previous, bool current);
+    void setChipSelects(uint16_t enabled);
+    void setGPIOs(uint16_t values);
+    uint8_t transferSPI(uint8_t mosi);
+    void writeDescGeneric(const std::u16string &descriptor, size_t index, size_t size);
+    bool writePROM(size_t index, const unsigned char *data, size_t size, uint16_t lockbits);
+
+public:
+    CP2130Emulator(uint16_t vid = CP2130::VID, uint16_t pid = CP2130::PID);
+
+    uint16_t getCS() const;
+    uint16_t getGPIOs() const;
+    bool hasResponse() const;
+    bool isValidRequest(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wLength) const;
+
+    void attach(uint8_t channel, SPISlave *slave);
+    void bulkOut(const unsigned char *data, size_t length);
+    int controlIn(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength);
+    bool controlOut(uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const unsigned char *data, uint16_t wLength);
+    TimeSource &getTimeSource();
+    std::vector<uint8_t> popResponse();
+    void reset();
+    void setInputs(uint16_t values, uint16_t mask);
+    void writeManufacturerDesc(const std::u16string &manufacturer);
+    void writePinConfig(const CP2130::PinConfig &config);
+    void writeProductDesc(const std::u16string &product);
+    void writeSerialDesc(const std::u16string &serial);
+    void writeUSBConfig(const CP2130::USBConfig &config);
+};
+
+#endif  // CP2130EMULATOR_H
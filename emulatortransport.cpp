@@ -0,0 +1,101 @@
+/* Emulator transport class - Version 1.0.0
+   Requires CP2130 class version 1.3.0 or later and CP2130 emulator class version 1.0.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <algorithm>
+#include <cstring>
+#include <libusb-1.0/libusb.h>
+#include "emulatortransport.h"
+#include "timesource.h"
+
+// The emulator is not owned by the transport, and must outlive it
+// The timing model sets by how much the clock of the emulator advances per transfer, which is relevant when virtual time is enabled on that clock (see getTimeSource())
+EmulatorTransport::EmulatorTransport(CP2130Emulator &emulator, const CP2130::TimingModel &timing) :
+    emulator_(emulator),
+    timing_(timing),
+    pending_(),
+    pendingIndex_(0)
+{
+}
+
+// Returns the timing model used by the transport
+CP2130::TimingModel EmulatorTransport::getTimingModel() const
+{
+    return timing_;
+}
+
+// Carries out a bulk transfer, feeding the emulator on the OUT endpoint and serving its queued responses on the IN endpoint
+// A response may be read in several transfers, as it happens with the real device, and reading with no response queued times out
+int EmulatorTransport::bulkTransfer(uint8_t endpointAddr, unsigned char *data, int length, int *transferred)
+{
+    int retval = 0;
+    *transferred = 0;
+    if ((LIBUSB_ENDPOINT_IN & endpointAddr) == 0x00) {  // Bulk OUT
+        emulator_.bulkOut(data, static_cast<size_t>(length));
+        *transferred = length;
+    } else {  // Bulk IN
+        if (pendingIndex_ >= pending_.size() && emulator_.hasResponse()) {
+            pending_ = emulator_.popResponse();
+            pendingIndex_ = 0;
+        }
+        if (pendingIndex_ >= pending_.size()) {
+            retval = LIBUSB_ERROR_TIMEOUT;
+        } else {
+            size_t bytesToCopy = std::min(static_cast<size_t>(length), pending_.size() - pendingIndex_);
+            std::memcpy(data, pending_.data() + pendingIndex_, bytesToCopy);
+            pendingIndex_ += bytesToCopy;
+            *transferred = static_cast<int>(bytesToCopy);
+        }
+    }
+    emulator_.getTimeSource().advance(timing_.bulktime + timing_.bytetime * *transferred);  // Only has an effect if virtual time is enabled
+    return retval;
+}
+
+// Carries out a control transfer, passing the request to the emulator
+// Requests rejected by the emulator are stalled, and LIBUSB_ERROR_PIPE is returned in that case, as libusb would
+int EmulatorTransport::controlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength)
+{
+    int retval;
+    if (!emulator_.isValidRequest(bmRequestType, bRequest, wValue, wLength)) {
+        retval = LIBUSB_ERROR_PIPE;
+    } else if ((LIBUSB_ENDPOINT_IN & bmRequestType) != 0x00) {  // Device-to-host request
+        retval = emulator_.controlIn(bRequest, wValue, wIndex, data, wLength);
+        if (retval < 0) {
+            retval = LIBUSB_ERROR_PIPE;
+        }
+    } else {  // Host-to-device request
+        retval = emulator_.controlOut(bRequest, wValue, wIndex, data, wLength) ? static_cast<int>(wLength) : static_cast<int>(LIBUSB_ERROR_PIPE);
+    }
+    emulator_.getTimeSource().advance(timing_.ctrltime);
+    return retval;
+}
+
+// Returns the clock of the emulator, which the device opened via the transport follows, and which can be made virtual via TimeSource::setVirtual(), without affecting any other device
+TimeSource &EmulatorTransport::getTimeSource()
+{
+    return emulator_.getTimeSource();
+}
+
+// Sets the timing model used by the transport
+void EmulatorTransport::setTimingModel(const CP2130::TimingModel &timing)
+{
+    timing_ = timing;
+}
@@ -0,0 +1,50 @@
+/* Emulator transport class - Version 1.0.0
+   Requires CP2130 class version 1.3.0 or later and CP2130 emulator class version 1.0.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef EMULATORTRANSPORT_H
+#define EMULATORTRANSPORT_H
+
+// Includes
+#include <cstdint>
+#include <vector>
+#include "cp2130.h"
+#include "cp2130emulator.h"
+
+class EmulatorTransport : public CP2130::Transport
+{
+private:
+    CP2130Emulator &emulator_;
+    CP2130::TimingModel timing_;
+    std::vector<uint8_t> pending_;
+    size_t pendingIndex_;
+
+public:
+    EmulatorTransport(CP2130Emulator &emulator, const CP2130::TimingModel &timing);
+
+    CP2130::TimingModel getTimingModel() const;
+
+    int bulkTransfer(uint8_t endpointAddr, unsigned char *data, int length, int *transferred) override;
+    int controlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength) override;
+    TimeSource &getTimeSource() override;
+    void setTimingModel(const CP2130::TimingModel &timing);
+};
+
+#endif  // EMULATORTRANSPORT_H
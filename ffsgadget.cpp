@@ -0,0 +1,306 @@
+/* FunctionFS gadget class - Version 1.0.0
+   Requires CP2130 emulator class version 1.0.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <cerrno>
+#include <deque>
+#include <endian.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <vector>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/usb/ch9.h>
+#include <linux/usb/functionfs.h>
+#include "ffsgadget.h"
+
+// Definitions
+const int POLL_TIMEOUT = 100;       // Timeout (in ms) used when polling the endpoints, which bounds the time taken by stop()
+const size_t EP0_BUFFER_SIZE = 64;  // Maximum length of the data stage of any vendor request used by the CP2130 class
+const size_t BULK_BUFFER_SIZE = 512;
+const unsigned int AIO_EVENTS = 2;  // Maximum number of AIO requests in flight (one read from the OUT endpoint, plus one write to the IN endpoint)
+const uint64_t AIO_READ = 0;        // Tag of the AIO read request
+const uint64_t AIO_WRITE = 1;       // Tag of the AIO write request
+
+// Descriptors written to "ep0", as per the FunctionFS v2 format
+// The interface has one bulk OUT endpoint followed by one bulk IN endpoint, matching the CP2130 when the transfer priority is set to high priority write
+struct FFSDescriptors {
+    usb_functionfs_descs_head_v2 header;
+    __le32 fsCount;
+    __le32 hsCount;
+    struct {
+        usb_interface_descriptor interface;
+        usb_endpoint_descriptor_no_audio epOut;
+        usb_endpoint_descriptor_no_audio epIn;
+    } __attribute__((packed)) fs, hs;
+} __attribute__((packed));
+
+// Strings written to "ep0" (none, since the string descriptors are set via configfs)
+struct FFSStrings {
+    usb_functionfs_strings_head header;
+} __attribute__((packed));
+
+// Submits the given AIO request, returning true if successful
+// The kernel AIO system calls are used directly, since glibc does not wrap them, and so that libaio is not required
+static bool aioSubmit(aio_context_t context, iocb *request)
+{
+    iocb *requests[1] = {request};
+    return syscall(__NR_io_submit, context, 1, requests) == 1;
+}
+
+// Private procedure that tears down the AIO context, cancelling any requests in flight, and then closes every endpoint file that is open
+void FFSGadget::closeEndpoints()
+{
+    if (aioContext_ != 0) {
+        syscall(__NR_io_destroy, aioContext_);  // Cancels any requests in flight, and waits for them to complete
+        aioContext_ = 0;
+    }
+    if (aioEvent_ != -1) {
+        close(aioEvent_);
+        aioEvent_ = -1;
+    }
+    int *fds[3] = {&epIn_, &epOut_, &ep0_};  // Data endpoints are closed first, since closing "ep0" unbinds the function
+    for (int *fd : fds) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+// Private procedure that relays bulk data, run by its own thread
+// Data received on the OUT endpoint is fed to the emulator, and any resulting responses are written to the IN endpoint
+// The endpoint files do not support poll(), and plain reads and writes block until the host transfers data. Hence, both endpoints are accessed via AIO, whose completions are signalled through an eventfd that can be polled, so that the running flag is always checked in time
+void FFSGadget::runBulk()
+{
+    std::vector<uint8_t> buffer(BULK_BUFFER_SIZE);
+    std::deque<std::vector<uint8_t>> responses;  // Responses waiting to be written, the first of which is in flight if "writing" is true
+    iocb readRequest = {};
+    readRequest.aio_data = AIO_READ;
+    readRequest.aio_lio_opcode = IOCB_CMD_PREAD;
+    readRequest.aio_fildes = static_cast<uint32_t>(epOut_);
+    readRequest.aio_buf = reinterpret_cast<uint64_t>(buffer.data());
+    readRequest.aio_nbytes = buffer.size();
+    readRequest.aio_flags = IOCB_FLAG_RESFD;  // Completions are signalled through the eventfd
+    readRequest.aio_resfd = static_cast<uint32_t>(aioEvent_);
+    iocb writeRequest = readRequest;
+    writeRequest.aio_data = AIO_WRITE;
+    writeRequest.aio_lio_opcode = IOCB_CMD_PWRITE;
+    writeRequest.aio_fildes = static_cast<uint32_t>(epIn_);
+    bool reading = false;
+    bool writing = false;
+    while (running_) {
+        if (!reading) {
+            reading = aioSubmit(aioContext_, &readRequest);  // If this fails (e.g., because the function is disabled), it is retried once the poll below times out
+        }
+        if (!writing && !responses.empty()) {
+            writeRequest.aio_buf = reinterpret_cast<uint64_t>(responses.front().data());
+            writeRequest.aio_nbytes = responses.front().size();
+            writing = aioSubmit(aioContext_, &writeRequest);
+        }
+        pollfd pfd = {aioEvent_, POLLIN, 0};
+        if (poll(&pfd, 1, POLL_TIMEOUT) <= 0) {  // Timed out or interrupted, so the running flag gets checked again
+            continue;
+        }
+        uint64_t completions;
+        (void)read(aioEvent_, &completions, sizeof(completions));  // Reset the eventfd counter
+        io_event events[AIO_EVENTS];
+        timespec nowait = {0, 0};
+        long count = syscall(__NR_io_getevents, aioContext_, 0, AIO_EVENTS, events, &nowait);
+        for (long i = 0; i < count; ++i) {
+            if (events[i].data == AIO_READ) {
+                reading = false;
+                if (events[i].res > 0) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    emulator_.bulkOut(buffer.data(), static_cast<size_t>(events[i].res));
+                    while (emulator_.hasResponse()) {
+                        responses.push_back(emulator_.popResponse());
+                    }
+                } else if (events[i].res == -ESHUTDOWN) {  // The function is disabled (e.g., not yet configured by the host), so retry later
+                    usleep(1000 * POLL_TIMEOUT);
+                }
+            } else {
+                writing = false;
+                if (events[i].res == -ESHUTDOWN) {  // Likewise, the response is written again later
+                    usleep(1000 * POLL_TIMEOUT);
+                } else {
+                    responses.pop_front();  // The response was either written, or it cannot be written at all
+                }
+            }
+        }
+    }
+}
+
+// Private procedure that handles the events received on "ep0", run by its own thread
+// Vendor requests are passed to the emulator, and stalled if the emulator rejects them
+void FFSGadget::runEP0()
+{
+    unsigned char data[EP0_BUFFER_SIZE];
+    while (running_) {
+        pollfd pfd = {ep0_, POLLIN, 0};
+        if (poll(&pfd, 1, POLL_TIMEOUT) <= 0) {
+            continue;
+        }
+        usb_functionfs_event event;
+        if (read(ep0_, &event, sizeof(event)) != static_cast<ssize_t>(sizeof(event)) || event.type != FUNCTIONFS_SETUP) {  // Events other than setup requests need no handling
+            continue;
+        }
+        uint8_t bmRequestType = event.u.setup.bRequestType;
+        uint8_t bRequest = event.u.setup.bRequest;
+        uint16_t wValue = le16toh(event.u.setup.wValue);
+        uint16_t wIndex = le16toh(event.u.setup.wIndex);
+        uint16_t wLength = le16toh(event.u.setup.wLength);
+        if (wLength > EP0_BUFFER_SIZE) {
+            wLength = static_cast<uint16_t>(EP0_BUFFER_SIZE);
+        }
+        if ((USB_DIR_IN & bmRequestType) != 0x00) {  // Device-to-host request
+            int length;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                length = emulator_.isValidRequest(bmRequestType, bRequest, wValue, wLength) ? emulator_.controlIn(bRequest, wValue, wIndex, data, wLength) : -1;
+            }
+            if (length < 0) {
+                (void)read(ep0_, data, 0);  // Reading in the wrong direction stalls the request
+            } else {
+                (void)write(ep0_, data, static_cast<size_t>(length));
+            }
+        } else {  // Host-to-device request
+            bool valid;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                valid = emulator_.isValidRequest(bmRequestType, bRequest, wValue, wLength);
+            }
+            if (!valid) {
+                (void)write(ep0_, data, 0);  // Writing in the wrong direction stalls the request, before its data stage
+            } else if (read(ep0_, data, wLength) == static_cast<ssize_t>(wLength)) {  // Reading the data stage also acknowledges the request
+                std::lock_guard<std::mutex> lock(mutex_);
+                emulator_.controlOut(bRequest, wValue, wIndex, data, wLength);
+            }
+        }
+    }
+}
+
+// The emulator is not owned by the gadget, and must outlive it
+FFSGadget::FFSGadget(CP2130Emulator &emulator) :
+    emulator_(emulator),
+    mutex_(),
+    ep0Thread_(),
+    bulkThread_(),
+    running_(false),
+    ep0_(-1),
+    epOut_(-1),
+    epIn_(-1),
+    aioContext_(0),
+    aioEvent_(-1)
+{
+}
+
+FFSGadget::~FFSGadget()
+{
+    stop();
+}
+
+// Checks if the gadget is running
+bool FFSGadget::isRunning() const
+{
+    return running_;
+}
+
+// Starts the gadget on the FunctionFS instance mounted at the given path
+// The gadget must then be bound to a UDC (e.g., the one provided by dummy_hcd) via configfs, so that the host can enumerate it
+void FFSGadget::start(const std::string &mountpoint, int &errcnt, std::string &errstr)
+{
+    if (running_) {
+        ++errcnt;
+        errstr += "In start(): gadget is already running.\n";  // Program logic error
+    } else {
+        ep0_ = ::open((mountpoint + "/ep0").c_str(), O_RDWR);
+        if (ep0_ == -1) {
+            ++errcnt;
+            errstr += "Could not open \"" + mountpoint + "/ep0\".\n";
+        } else {
+            FFSDescriptors descriptors = {};
+            descriptors.header.magic = htole32(FUNCTIONFS_DESCRIPTORS_MAGIC_V2);
+            descriptors.header.flags = htole32(FUNCTIONFS_HAS_FS_DESC | FUNCTIONFS_HAS_HS_DESC | FUNCTIONFS_ALL_CTRL_RECIP);  // Vendor requests addressed to the device are forwarded too
+            descriptors.header.length = htole32(sizeof(descriptors));
+            descriptors.fsCount = htole32(3);
+            descriptors.hsCount = htole32(3);
+            uint16_t packetSizes[2] = {64, 512};  // Full speed and high speed bulk packet sizes
+            decltype(descriptors.fs) *speeds[2] = {&descriptors.fs, &descriptors.hs};
+            for (size_t i = 0; i < 2; ++i) {
+                speeds[i]->interface.bLength = sizeof(speeds[i]->interface);
+                speeds[i]->interface.bDescriptorType = USB_DT_INTERFACE;
+                speeds[i]->interface.bNumEndpoints = 2;
+                speeds[i]->interface.bInterfaceClass = USB_CLASS_VENDOR_SPEC;
+                speeds[i]->epOut.bLength = sizeof(speeds[i]->epOut);
+                speeds[i]->epOut.bDescriptorType = USB_DT_ENDPOINT;
+                speeds[i]->epOut.bEndpointAddress = 1 | USB_DIR_OUT;
+                speeds[i]->epOut.bmAttributes = USB_ENDPOINT_XFER_BULK;
+                speeds[i]->epOut.wMaxPacketSize = htole16(packetSizes[i]);
+                speeds[i]->epIn.bLength = sizeof(speeds[i]->epIn);
+                speeds[i]->epIn.bDescriptorType = USB_DT_ENDPOINT;
+                speeds[i]->epIn.bEndpointAddress = 2 | USB_DIR_IN;
+                speeds[i]->epIn.bmAttributes = USB_ENDPOINT_XFER_BULK;
+                speeds[i]->epIn.wMaxPacketSize = htole16(packetSizes[i]);
+            }
+            FFSStrings strings = {};
+            strings.header.magic = htole32(FUNCTIONFS_STRINGS_MAGIC);
+            strings.header.length = htole32(sizeof(strings));
+            if (write(ep0_, &descriptors, sizeof(descriptors)) != static_cast<ssize_t>(sizeof(descriptors)) || write(ep0_, &strings, sizeof(strings)) != static_cast<ssize_t>(sizeof(strings))) {
+                ++errcnt;
+                errstr += "Failed to write descriptors to \"" + mountpoint + "/ep0\".\n";
+                closeEndpoints();
+            } else {
+                epOut_ = ::open((mountpoint + "/ep1").c_str(), O_RDWR);  // Endpoint files are only created after the descriptors are written
+                epIn_ = ::open((mountpoint + "/ep2").c_str(), O_RDWR);
+                if (epOut_ == -1 || epIn_ == -1) {
+                    ++errcnt;
+                    errstr += "Could not open the endpoint files in \"" + mountpoint + "\".\n";
+                    closeEndpoints();
+                } else if ((aioEvent_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1 || syscall(__NR_io_setup, AIO_EVENTS, &aioContext_) != 0) {  // The bulk endpoints are accessed via AIO (see runBulk())
+                    ++errcnt;
+                    errstr += "Could not set up asynchronous I/O.\n";
+                    aioContext_ = 0;
+                    closeEndpoints();
+                } else {
+                    running_ = true;
+                    ep0Thread_ = std::thread(&FFSGadget::runEP0, this);
+                    bulkThread_ = std::thread(&FFSGadget::runBulk, this);
+                }
+            }
+        }
+    }
+}
+
+// Stops the gadget, closing all endpoint files (this unbinds the function, and the host sees the device disconnecting)
+// Both threads check the running flag at least once per poll timeout, even if the host is idle, and any bulk transfers still in flight are cancelled afterwards
+void FFSGadget::stop()
+{
+    running_ = false;
+    if (ep0Thread_.joinable()) {
+        ep0Thread_.join();
+    }
+    if (bulkThread_.joinable()) {
+        bulkThread_.join();
+    }
+    closeEndpoints();
+}
@@ -0,0 +1,58 @@
+/* FunctionFS gadget class - Version 1.0.0
+   Requires CP2130 emulator class version 1.0.0 or later
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef FFSGADGET_H
+#define FFSGADGET_H
+
+// Includes
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <linux/aio_abi.h>
+#include "cp2130emulator.h"
+
+class FFSGadget
+{
+private:
+    CP2130Emulator &emulator_;
+    std::mutex mutex_;
+    std::thread ep0Thread_, bulkThread_;
+    std::atomic<bool> running_;
+    int ep0_, epOut_, epIn_;
+    aio_context_t aioContext_;
+    int aioEvent_;
+
+    void closeEndpoints();
+    void runBulk();
+    void runEP0();
+
+public:
+    explicit FFSGadget(CP2130Emulator &emulator);
+    ~FFSGadget();
+
+    bool isRunning() const;
+
+    void start(const std::string &mountpoint, int &errcnt, std::string &errstr);
+    void stop();
+};
+
+#endif  // FFSGADGET_H
@@ -1,5 +1,5 @@
-/* GF1 device class - Version 1.0.1
-   Requires CP2130 class version 1.1.0 or later
+/* GF1 device class - Version 1.1.0
+   Requires CP2130 class version 1.3.0 or later
    Copyright (c) 2022 Samuel Lourenço
 
    This library is free software: you can redistribute it and/or modify it
@@ -20,16 +20,39 @@
 
 
 // Includes
+#include <algorithm>
 #include <cmath>
-#include <sstream>
-#include <unistd.h>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <thread>
 #include <vector>
+#include <unistd.h>
 #include "gf1device.h"
+#include "timesource.h"
 
 // Definitions
 const uint8_t EPOUT = 0x01;      // Address of endpoint assuming the OUT direction
+const uint8_t NINCR = 0x10;      // Mask for the number of increments register
+const uint8_t DFLSB = 0x20;      // Mask for the delta frequency LSBs register
+const uint8_t DFMSB = 0x30;      // Mask for the delta frequency MSBs register
+const uint8_t TINT = 0x40;       // Mask for the increment interval register
 const uint8_t FSTARTLSB = 0xc0;  // Mask for the Fstart LSBs register
 const uint8_t FSTARTMSB = 0xd0;  // Mask for the Fstart MSBs register
+const uint8_t DFNEG = 0x08;      // Mask for the sign bit of the delta frequency MSBs register (negative increments)
+const uint8_t TINTMCLK = 0x20;   // Mask for the increment interval mode bit (interval given in MCLK periods)
+const uint8_t B24 = 0x08;        // Mask for the B24 bit of the control register (if cleared, the Fstart LSBs and MSBs registers can be written independently)
+
+// Timing constants (added in version 1.1.0)
+const double CS_DELAY = 100;  // Delay (in us) applied after enabling and before disabling any chip select, as a workaround (see the timeSource().sleep() calls, which only skip the delay if the device is simulated and follows virtual time)
+
+// Specific to glide() (added in version 1.1.0)
+const double GLD_ALPHA = 0.2;    // Smoothing factor of the update latency estimates
+const double GLD_MARGIN = 1.25;  // Safety factor applied to the update latency estimate, when working out when the last update must start
+
+// Specific to soak() (added in version 1.1.0)
+const uint32_t SOAK_KINDS = 8;  // Number of kinds of operations mixed by soak()
 
 // Amplitude conversion constants
 const uint AQUANTUM = 255;  // Quantum related to the 8-bit resolution of the AD5160 SPI potentiometer
@@ -38,17 +61,178 @@ const uint AQUANTUM = 255;  // Quantum related to the 8-bit resolution of the AD
 const uint FQUANTUM = 16777216;  // Quantum related to the 24-bit frequency resolution of the AD5932 waveform generator
 const float MCLK = 50000;        // 50MHz clock
 
+// Sweep timing constants (added in version 1.1.0)
+const uint TINTMULTIPLIERS[4] = {1, 5, 100, 500};  // Increment interval multipliers, indexed by the values applicable to Sweep/setSweep()
+
+// Trigger constants (added in version 1.1.0)
+const uint16_t TRGBITMAPS[7] = {  // Bitmaps of the pins that can be used by armTrigger(), from GPIO.4 to GPIO.10
+    CP2130::BMGPIO4, CP2130::BMGPIO5, CP2130::BMGPIO6, CP2130::BMGPIO7, CP2130::BMGPIO8, CP2130::BMGPIO9, CP2130::BMGPIO10
+};
+
+// Process-wide device registry, used by acquire() (added in version 1.1.0)
+// Each entry refers to the device object shared by every holder of the given serial number, and expires once the last holder lets go of it
+static std::mutex registryMutex;
+static std::map<std::string, std::weak_ptr<GF1Device>> registry;
+
+// Private function that recovers the device via recover(), if the watchdog tripped, the watchdog policy calls for proactive recovery, and the cooldown period has elapsed (added in version 1.1.0)
+void GF1Device::checkWatchdog(int &errcnt, std::string &errstr)
+{
+    CP2130::WatchdogPolicy policy = cp2130_.getWatchdogPolicy();
+    std::chrono::steady_clock::time_point now = timeSource().now();
+    if (policy.recover && cp2130_.getWatchdogStatus().tripped && (lastRecovery_ == std::chrono::steady_clock::time_point() || std::chrono::duration<double>(now - lastRecovery_).count() >= policy.cooldown)) {
+        lastRecovery_ = now;
+        recover(errcnt, errstr);
+    }
+}
+
+// Private function that discards any stale cancellation request, at the start of a cancellable operation (added in version 1.1.0)
+// While the device is locked (see lock()), the request is kept, since it is cleared whenever access is granted, and was thus meant for the current holder (e.g., made by a critical waiter before the operation started)
+void GF1Device::clearCancel()
+{
+    std::lock_guard<std::mutex> guard(queueMutex_);
+    if (!queueBusy_) {
+        cancelRequested_ = false;
+    }
+}
+
 // Private convenience function that is used to clear the signals going to the CTRL and INTERRUPT pins on the AD5932 waveform generator
 void GF1Device::clearCtrlInterrupt(int &errcnt, std::string &errstr)
 {
-    cp2130_.setGPIO2(false, errcnt, errstr);  // Set GPIO.2 low (corresponds to the CTRL pin)
-    cp2130_.setGPIO3(false, errcnt, errstr);  // Set GPIO.3 low (corresponds to the INTERRUPT pin)
+    cp2130_.setGPIOs(0x0000, CP2130::BMGPIO2 | CP2130::BMGPIO3, errcnt, errstr);  // Set both GPIO.2 (corresponds to the CTRL pin) and GPIO.3 (corresponds to the INTERRUPT pin) low, using a single write (since version 1.1.0)
+}
+
+// Private convenience function used to mark the state of the device as unknown, in respect to its registers and output (added in version 1.1.0)
+void GF1Device::forgetState()
+{
+    programmed_.active = false;
+    timeline_.active = false;
+    waveformKnown_ = false;
+    amplitudeKnown_ = false;
+    trigger_.armed = false;  // The trigger must be armed again, since the state of its pin is not known either
+}
+
+// Private function that grants access to the next waiting operation, or marks the device as idle if none is waiting (added in version 1.1.0)
+// Operations that waited beyond the target of their priority class go first, earliest deadline first. Otherwise, the highest priority class goes first, and operations within the same class are served by increasing virtual finish time, which shares the device among submitters in proportion to their weights
+// Must be called with "queueMutex_" held
+void GF1Device::serveNext()
+{
+    if (waiters_.empty()) {
+        queueBusy_ = false;
+    } else {
+        std::chrono::steady_clock::time_point now = timeSource().now();
+        std::list<Waiter>::iterator best = waiters_.end();
+        bool bestOverdue = false;
+        std::chrono::steady_clock::time_point bestDeadline;
+        for (std::list<Waiter>::iterator it = waiters_.begin(); it != waiters_.end(); ++it) {
+            std::chrono::steady_clock::time_point deadline = it->arrival + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::micro>(schpolicy_.targets[it->prioclass]));
+            bool overdue = now > deadline;
+            bool better;
+            if (best == waiters_.end() || overdue != bestOverdue) {
+                better = best == waiters_.end() || overdue;
+            } else if (overdue) {
+                better = deadline < bestDeadline;
+            } else {
+                better = it->prioclass < best->prioclass || (it->prioclass == best->prioclass && it->finish < best->finish);
+            }
+            if (better) {
+                best = it;
+                bestOverdue = overdue;
+                bestDeadline = deadline;
+            }
+        }
+        double delay = std::chrono::duration<double, std::micro>(now - best->arrival).count();
+        schstats_.delay[best->prioclass].add(delay);
+        if (bestOverdue) {
+            ++schstats_.missed[best->prioclass];
+        }
+        queueVirtual_ = best->finish;  // The virtual time follows the finish time of the operation being served
+        servingTicket_ = best->ticket;
+        servingClass_ = best->prioclass;
+        queueBusy_ = true;
+        cancelRequested_ = false;  // Cancellation requests are tied to the holder they were made for, and a new holder starts without any (since version 1.1.0)
+        waiters_.erase(best);
+        queueCond_.notify_all();
+    }
+}
+
+// Private convenience function used to write the given amplitude code to the AD5160, without touching the AD5932 or the CTRL and INTERRUPT signals (added in version 1.1.0)
+void GF1Device::stageAmplitude(uint8_t code, int &errcnt, std::string &errstr)
+{
+    cp2130_.selectCS(1, errcnt, errstr);  // Enable the chip select corresponding to channel 1, and disable any others
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+    std::vector<uint8_t> setAmplitude = {
+        code  // Amplitude
+    };
+    cp2130_.spiWrite(setAmplitude, EPOUT, errcnt, errstr);  // Set the amplitude of the output signal (AD5160 on channel 1)
+    amplitudeCode_ = code;
+    amplitudeKnown_ = true;
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+    cp2130_.disableCS(1, errcnt, errstr);  // Disable the previously enabled chip select
+}
+
+// Private convenience function used to write the waveform and frequency of a given compiled point to the AD5932, without touching the CTRL and INTERRUPT signals (added in version 1.1.0)
+// The output is not disturbed, since the written registers only take effect on the next toggle of the CTRL signal
+void GF1Device::stageFrequency(const CompiledPreset &point, int &errcnt, std::string &errstr)
+{
+    cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+    cp2130_.spiWrite(point.frequencyFrame, EPOUT, errcnt, errstr);  // Set the waveform and the frequency (AD5932 on channel 0)
+    programmed_ = {true, std::chrono::steady_clock::time_point(), point.frequencyCode, 0, 0, 0};  // Keep track of the programmed registers
+    waveform_ = point.waveform;
+    waveformKnown_ = true;
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+    cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
+}
+
+// Private convenience function used to write the frames of a given compiled preset, without toggling the CTRL signal (added in version 1.1.0)
+// If "diff" is true, only the frames that differ from the known state of the device are written, unless "force" is also true, in which case the output is always halted
+// Returns true if the CTRL signal must be toggled afterwards, in order for the preset to take effect
+bool GF1Device::stagePreset(const CompiledPreset &preset, bool diff, bool force, int &errcnt, std::string &errstr)
+{
+    bool writeFrequency = !diff || !waveformKnown_ || waveform_ != preset.waveform || !programmed_.active || programmed_.start != preset.frequencyCode || programmed_.nincr != 0;
+    bool writeAmplitude = !diff || !amplitudeKnown_ || amplitudeCode_ != preset.amplitudeCode;
+    bool startOutput = force || writeFrequency || !timeline_.active;
+    if (startOutput) {
+        clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
+        toggleInterrupt(errcnt, errstr);  // Toggle "INTERRUPT" signal, in order to terminate any sweep in progress
+    }
+    if (writeFrequency) {
+        cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
+        timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+        cp2130_.spiWrite(preset.frequencyFrame, EPOUT, errcnt, errstr);  // Set the waveform and the frequency (AD5932 on channel 0)
+        programmed_ = {true, std::chrono::steady_clock::time_point(), preset.frequencyCode, 0, 0, 0};  // Keep track of the programmed registers
+        waveform_ = preset.waveform;
+        waveformKnown_ = true;
+        timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while switching or disabling the chip select (workaround)
+    }
+    if (writeAmplitude) {
+        cp2130_.selectCS(1, errcnt, errstr);  // Enable the chip select corresponding to channel 1, and disable any others (including the one corresponding to channel 0, if previously enabled)
+        timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+        cp2130_.spiWrite(preset.amplitudeFrame, EPOUT, errcnt, errstr);  // Set the amplitude (AD5160 on channel 1)
+        amplitudeCode_ = preset.amplitudeCode;
+        amplitudeKnown_ = true;
+        timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+    }
+    if (writeFrequency || writeAmplitude) {
+        cp2130_.disableCS(writeAmplitude ? 1 : 0, errcnt, errstr);  // Disable the chip select that was enabled last
+    }
+    return startOutput;
+}
+
+// Private function that returns the clock followed by the device, which is virtual only if the device is simulated and its clock was made virtual (added in version 1.1.0)
+TimeSource &GF1Device::timeSource() const
+{
+    return cp2130_.getTimeSource();
 }
 
 // Private convenience function used to toggle the signal going to the CTRL pin on the AD5932 waveform generator
 void GF1Device::toggleCtrl(int &errcnt, std::string &errstr)
 {
     cp2130_.setGPIO2(true, errcnt, errstr);  // Set GPIO.2 to a logical high
+    cp2130_.flushGPIOs(errcnt, errstr);  // Make sure that the rising edge takes place at this point, if GPIO writes are being combined (since version 1.1.0)
+    cp2130_.flushTransfers(errcnt, errstr);  // Likewise, wait for the rising edge to actually take place, if transfers are being batched
+    timeline_ = programmed_;  // The output now follows the programmed registers, and it is only known if these are known as well (since version 1.1.0)
+    timeline_.anchor = timeSource().now();  // Anchor the timeline of the output to the rising edge of the CTRL signal
     cp2130_.setGPIO2(false, errcnt, errstr);  // and then to a logical low
 }
 
@@ -56,11 +240,252 @@ void GF1Device::toggleCtrl(int &errcnt, std::string &errstr)
 void GF1Device::toggleInterrupt(int &errcnt, std::string &errstr)
 {
     cp2130_.setGPIO3(true, errcnt, errstr);  // Set GPIO.3 to a logical high
+    timeline_.active = false;  // The INTERRUPT signal terminates the output (since version 1.1.0)
     cp2130_.setGPIO3(false, errcnt, errstr);  // and then to a logical low
 }
-    
+
+// Private helper function that returns the amplitude code corresponding to a given amplitude value (added in version 1.1.0)
+uint8_t GF1Device::amplitudeCode(float amplitude)
+{
+    return static_cast<uint8_t>(amplitude * AQUANTUM / AMPLITUDE_MAX + 0.5);
+}
+
+// Private helper function that compiles the frames that set the given waveform, frequency code and amplitude code (added in version 1.1.0)
+GF1Device::CompiledPreset GF1Device::compilePreset(uint8_t waveform, uint32_t frequencyCode, uint8_t amplitudeCode)
+{
+    CompiledPreset compiled;
+    compiled.waveform = waveform;
+    compiled.frequencyCode = frequencyCode;
+    compiled.amplitudeCode = amplitudeCode;
+    compiled.frequencyFrame = {
+        static_cast<uint8_t>(waveform == WFTRIANGLE ? 0x0d : 0x0f), 0xdf,  // Sinusoidal or triangular waveform, automatic increments, MSBOUT pin enabled, SYNCOUT pin enabled, B24 = 1, SYNCSEL = 1
+        0x10, 0x00,                                                        // Zero frequency increments
+        0x20, 0x00, 0x30, 0x00,                                            // Delta frequency set to zero
+        0x40, 0x00,                                                        // Increment interval set to zero
+        static_cast<uint8_t>(FSTARTLSB | (0x0f & frequencyCode >> 8)),     // Start frequency (Fstart LSBs register)
+        static_cast<uint8_t>(frequencyCode),
+        static_cast<uint8_t>(FSTARTMSB | (0x0f & frequencyCode >> 20)),    // Start frequency (Fstart MSBs register)
+        static_cast<uint8_t>(frequencyCode >> 12)
+    };
+    compiled.amplitudeFrame = {
+        amplitudeCode  // Amplitude
+    };
+    return compiled;
+}
+
+// Private helper function that returns the frequency code corresponding to a given frequency value (added in version 1.1.0)
+uint32_t GF1Device::frequencyCode(float frequency)
+{
+    return static_cast<uint32_t>(frequency * FQUANTUM / MCLK + 0.5);
+}
+
+// Private helper function that returns the resident set size of the process (in KiB), as given by "/proc/self/statm", or zero if not available (added in version 1.1.0)
+uint64_t GF1Device::residentSetSize()
+{
+    uint64_t rss = 0;
+    std::FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm != nullptr) {
+        unsigned long size, resident;
+        if (std::fscanf(statm, "%lu %lu", &size, &resident) == 2) {  // The second field is the resident set size, in pages
+            rss = static_cast<uint64_t>(resident) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) / 1024;
+        }
+        std::fclose(statm);
+    }
+    return rss;
+}
+
+// Private helper function that validates the given sweep parameters, returning the reason why these are invalid, or an empty string if they are valid (added in version 1.1.0)
+std::string GF1Device::sweepError(const Sweep &sweep)
+{
+    int64_t startCode = static_cast<int64_t>(std::round(sweep.start * FQUANTUM / MCLK));
+    int32_t deltaCode = static_cast<int32_t>(std::round(sweep.delta * FQUANTUM / MCLK));
+    int64_t finalCode = startCode + static_cast<int64_t>(sweep.nincr) * deltaCode;
+    std::string error;
+    if (sweep.start < FREQUENCY_MIN || sweep.start > FREQUENCY_MAX) {
+        error = "Start frequency must be between 0 and 25000.\n";
+    } else if (sweep.nincr < NINCR_MIN || sweep.nincr > NINCR_MAX) {
+        error = "Number of increments must be between 2 and 4095.\n";
+    } else if (sweep.tint < TINT_MIN || sweep.tint > TINT_MAX) {
+        error = "Increment interval must be between 2 and 2047.\n";
+    } else if (sweep.tintmult > TINTMULT500) {
+        error = "Increment interval multiplier value must be between 0 and 3.\n";
+    } else if (finalCode < 0 || finalCode > std::round(FREQUENCY_MAX * FQUANTUM / MCLK)) {
+        error = "Final frequency must be between 0 and 25000.\n";
+    }
+    return error;
+}
+
+// "Equal to" operator for Preset
+bool GF1Device::Preset::operator ==(const GF1Device::Preset &other) const
+{
+    return waveform == other.waveform && frequency == other.frequency && amplitude == other.amplitude;
+}
+
+// "Not equal to" operator for Preset
+bool GF1Device::Preset::operator !=(const GF1Device::Preset &other) const
+{
+    return !(operator ==(other));
+}
+
+// "Equal to" operator for Sweep
+bool GF1Device::Sweep::operator ==(const GF1Device::Sweep &other) const
+{
+    return start == other.start && delta == other.delta && nincr == other.nincr && tint == other.tint && tintmult == other.tintmult;
+}
+
+// "Not equal to" operator for Sweep
+bool GF1Device::Sweep::operator !=(const GF1Device::Sweep &other) const
+{
+    return !(operator ==(other));
+}
+
+// Private class constructor that waits for exclusive access to the given device, as a normal priority operation from the default submitter, if the device is shared via acquire() and not already held by the calling thread (added in version 1.1.0)
+GF1Device::Access::Access(GF1Device &device) :
+    device_(device),
+    locked_(false)
+{
+    if (device.shared_) {
+        bool held;
+        {
+            std::lock_guard<std::mutex> guard(device.queueMutex_);
+            held = device.queueBusy_ && device.holder_ == std::this_thread::get_id();
+        }
+        if (!held) {
+            device.lock();
+            locked_ = true;
+        }
+    }
+}
+
+// Releases the access to the device, if it was taken by the constructor
+GF1Device::Access::~Access()
+{
+    if (locked_) {
+        device_.unlock();
+    }
+}
+
+// Default constructor for TriggerStats
+GF1Device::TriggerStats::TriggerStats() :
+    fired(0),
+    timeouts(0),
+    polls(0),
+    latency(),
+    period()
+{
+}
+
+// Default constructor for StepStats (added in version 1.1.0)
+GF1Device::StepStats::StepStats() :
+    points(0),
+    elapsed(0),
+    rate(0),
+    steplat(),
+    stagelat(),
+    cancelled(false)
+{
+}
+
+// Default constructor for LevelingStats (added in version 1.1.0)
+GF1Device::LevelingStats::LevelingStats() :
+    updates(0),
+    skipped(0),
+    lateness(),
+    cancelled(false),
+    interrupted(false)
+{
+}
+
+// Default constructor for GlideStats (added in version 1.1.0)
+GF1Device::GlideStats::GlideStats() :
+    updates(0),
+    elapsed(0),
+    lateness(0),
+    updlat(),
+    cancelled(false)
+{
+}
+
+// Default constructor for HopStats (added in version 1.1.0)
+GF1Device::HopStats::HopStats() :
+    errors(),
+    alignment(),
+    skew(),
+    hops(0),
+    cancelled(false)
+{
+}
+
+// Default constructor for SoakPolicy (added in version 1.1.0)
+GF1Device::SoakPolicy::SoakPolicy() :
+    operations(1000000),  // One million operations
+    interval(10000),      // One sample every 10000 operations
+    seed(1),
+    rssdrift(1024),       // 1MiB of growth
+    bufdrift(0.01),       // One buffer growth per 100 operations, since transfer buffers are reused
+    allocdrift(1),        // One more heap allocation per operation than in the first sample
+    latdrift(2),          // Twice the 99th percentile latency of the first sample
+    alloccounter()        // Heap allocations are not counted by default
+{
+}
+
+// Default constructor for SoakStats (added in version 1.1.0)
+GF1Device::SoakStats::SoakStats() :
+    baseline(),
+    last(),
+    operations(0),
+    errors(0),
+    drifts(0),
+    latency(),
+    cancelled(false)
+{
+}
+
+// Default constructor for SchedulerPolicy (added in version 1.1.0)
+GF1Device::SchedulerPolicy::SchedulerPolicy() :
+    targets{2000, 20000, 200000}  // 2ms for critical operations, 20ms for normal operations and 200ms for background operations
+{
+}
+
+// Default constructor for SchedulerStats (added in version 1.1.0)
+GF1Device::SchedulerStats::SchedulerStats() :
+    delay(),
+    missed()
+{
+}
+
 GF1Device::GF1Device() :
-    cp2130_()
+    cp2130_(),
+    programmed_(),
+    timeline_(),
+    cfrq0_(CP2130::CFRQ12M),
+    cfrq1_(CP2130::CFRQ12M),
+    waveformKnown_(false),
+    amplitudeKnown_(false),
+    waveform_(WFSINE),
+    amplitudeCode_(0),
+    presets_(),
+    trigger_(),
+    trgstats_(),
+    queueMutex_(),
+    queueCond_(),
+    nextTicket_(0),
+    servingTicket_(0),
+    queueBusy_(false),
+    servingClass_(PRIONORMAL),
+    cancelRequested_(false),
+    holder_(),
+    shared_(false),
+    claims_(0),
+    queueVirtual_(0),
+    waiters_(),
+    submitterFinish_(),
+    submitterWeights_(),
+    schpolicy_(),
+    schstats_(),
+    lastRecovery_(),
+    leveling_(),
+    profiler_()
 {
 }
 
@@ -70,18 +495,167 @@ bool GF1Device::disconnected() const
     return cp2130_.disconnected();
 }
 
+// Returns the frequency (in KHz) that the device is expected to be generating at the given host timestamp (added in version 1.1.0)
+// This value is derived from the timeline of the current output, which is anchored to the last toggle of the CTRL signal, so no USB transfers are required
+// Note that the function returns zero if no output is known to be generated, or if the given timestamp precedes the start of the current output
+float GF1Device::frequencyAt(std::chrono::steady_clock::time_point time) const
+{
+    float frequency;
+    if (!timeline_.active || time < timeline_.anchor) {
+        frequency = 0;
+    } else {
+        uint32_t increments = timeline_.nincr;  // Number of increments elapsed, assuming that the sweep is complete
+        double elapsed = std::chrono::duration<double, std::micro>(time - timeline_.anchor).count();
+        if (timeline_.tint > 0 && elapsed < increments * timeline_.tint) {  // If the sweep is still in progress
+            increments = static_cast<uint32_t>(elapsed / timeline_.tint);
+        }
+        frequency = static_cast<float>((timeline_.start + static_cast<int64_t>(increments) * timeline_.delta) * MCLK / FQUANTUM);
+    }
+    return frequency;
+}
+
+// Returns the frequency (in KHz) that the device is expected to be generating at this moment, without requiring any USB transfers (added in version 1.1.0)
+float GF1Device::instantaneousFrequency() const
+{
+    return frequencyAt(timeSource().now());
+}
+
+// Returns the amplitude (in Vpp) given by the leveling table for the given frequency (in KHz), interpolating linearly between adjacent points (added in version 1.1.0)
+// Frequencies outside the table get the amplitude of the nearest point, and zero is returned if the table is empty
+float GF1Device::leveledAmplitude(float frequency) const
+{
+    float amplitude = 0;
+    if (!leveling_.empty()) {
+        if (frequency <= leveling_.front().frequency) {
+            amplitude = leveling_.front().amplitude;
+        } else if (frequency >= leveling_.back().frequency) {
+            amplitude = leveling_.back().amplitude;
+        } else {
+            size_t i = 1;
+            while (leveling_[i].frequency < frequency) {  // Find the first point at or above the given frequency
+                ++i;
+            }
+            const LevelingPoint &lower = leveling_[i - 1];
+            const LevelingPoint &upper = leveling_[i];
+            amplitude = lower.amplitude + (upper.amplitude - lower.amplitude) * (frequency - lower.frequency) / (upper.frequency - lower.frequency);
+        }
+    }
+    return amplitude;
+}
+
 // Checks if the device is open
 bool GF1Device::isOpen() const
 {
     return cp2130_.isOpen();
 }
 
+// Checks if profiling is enabled (added in version 1.1.0)
+bool GF1Device::isProfiling() const
+{
+    return profiler_.isEnabled();
+}
+
+// Checks if a frequency sweep is expected to be in progress (added in version 1.1.0)
+bool GF1Device::isSweeping() const
+{
+    return timeline_.active && timeline_.nincr > 0 && timeSource().now() < timeline_.anchor + std::chrono::duration<double, std::micro>(timeline_.nincr * timeline_.tint);
+}
+
+// Checks if the trigger is armed (added in version 1.1.0)
+bool GF1Device::isTriggerArmed() const
+{
+    return trigger_.armed;
+}
+
+// Validates the given preset and compiles it into the frames required to recall it, adding it to the preset bank (added in version 1.1.0)
+// Presets are indexed by the order in which they are added, starting from zero
+void GF1Device::addPreset(const Preset &preset, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    if (preset.waveform != WFSINE && preset.waveform != WFTRIANGLE) {
+        ++errcnt;
+        errstr += "In addPreset(): Waveform value must be either 0 or 1.\n";  // Program logic error
+    } else if (preset.frequency < FREQUENCY_MIN || preset.frequency > FREQUENCY_MAX) {
+        ++errcnt;
+        errstr += "In addPreset(): Frequency must be between 0 and 25000.\n";  // Program logic error
+    } else if (preset.amplitude < AMPLITUDE_MIN || preset.amplitude > AMPLITUDE_MAX) {
+        ++errcnt;
+        errstr += "In addPreset(): Amplitude must be between 0 and 5.\n";  // Program logic error
+    } else {
+        presets_.push_back(compilePreset(preset.waveform, frequencyCode(preset.frequency), amplitudeCode(preset.amplitude)));
+    }
+}
+
+// Arms the trigger, after staging the frames of the preset having the given index (added in version 1.1.0)
+// The preset is written in full, so that waitTrigger() only has to toggle the CTRL signal when the trigger fires
+void GF1Device::armTrigger(size_t index, uint8_t pin, uint8_t edge, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    if (index >= presets_.size()) {
+        ++errcnt;
+        errstr += "In armTrigger(): Preset index is out of range.\n";  // Program logic error
+    } else {
+        cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes
+        cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use (since version 1.1.0)
+        stagePreset(presets_[index], false, true, errcnt, errstr);  // Write the frames of the preset, halting the output
+        cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+        cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+        armTrigger(pin, edge, errcnt, errstr);
+    }
+}
+
+// Arms the trigger, so that the output is started by waitTrigger() as soon as the given edge is detected on the given GPIO pin (added in version 1.1.0)
+// The output is halted, and the registers that were programmed beforehand (e.g. via setFrequency() or setSweep()) take effect when the trigger fires
+// Only GPIO.4 to GPIO.10 can be used, since GPIO.0 and GPIO.1 are used as chip selects, and GPIO.2 and GPIO.3 drive the CTRL and INTERRUPT pins
+void GF1Device::armTrigger(uint8_t pin, uint8_t edge, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    if (pin < 4 || pin > 10) {
+        ++errcnt;
+        errstr += "In armTrigger(): Pin number must be between 4 and 10.\n";  // Program logic error
+    } else if (edge > TRGBOTH) {
+        ++errcnt;
+        errstr += "In armTrigger(): Edge value must be between 0 and 2.\n";  // Program logic error
+    } else {
+        int errcntArm = 0;
+        stop(errcntArm, errstr);  // Halt the output, leaving both "CTRL" and "INTERRUPT" signals low
+        cp2130_.configureGPIO(pin, CP2130::PCIN, false, errcntArm, errstr);  // Configure the trigger pin as an input
+        trigger_.bitmap = TRGBITMAPS[pin - 4];
+        trigger_.edge = edge;
+        trigger_.fire[0] = static_cast<uint8_t>(CP2130::BMGPIO2 >> 8);  // GPIO values bitmap, having GPIO.2 high
+        trigger_.fire[1] = static_cast<uint8_t>(CP2130::BMGPIO2);
+        trigger_.fire[2] = static_cast<uint8_t>(CP2130::BMGPIO2 >> 8);  // Mask bitmap, so that only GPIO.2 is affected
+        trigger_.fire[3] = static_cast<uint8_t>(CP2130::BMGPIO2);
+        trigger_.release[0] = 0x00;  // GPIO values bitmap, having GPIO.2 low
+        trigger_.release[1] = 0x00;
+        trigger_.release[2] = static_cast<uint8_t>(CP2130::BMGPIO2 >> 8);  // Mask bitmap, so that only GPIO.2 is affected
+        trigger_.release[3] = static_cast<uint8_t>(CP2130::BMGPIO2);
+        trigger_.level = (trigger_.bitmap & cp2130_.getGPIOs(errcntArm, errstr)) != 0x0000;  // Sample the initial level, so that the edge can be detected
+        trigger_.armed = errcntArm == 0;
+        errcnt += errcntArm;
+    }
+}
+
+// Calibrates the timing model used by estimateDuration(), against the transfer durations measured so far (added in version 1.1.0)
+void GF1Device::calibrateTimingModel()
+{
+    Access access(*this);
+    cp2130_.calibrateTimingModel();
+}
+
 // Sets the frequency and amplitude of the generated signal to zero, and sets its waveform to sinusoidal
 void GF1Device::clear(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes (since version 1.1.0)
+    cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use (since version 1.1.0)
     clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
     cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
-    usleep(100);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
     std::vector<uint8_t> clearFrequency = {
         0x0f, 0xdf,                       // Sinusoidal waveform, automatic increments, MSBOUT pin enabled, SYNCOUT pin enabled, B24 = 1, SYNCSEL = 1
         0x10, 0x00,                       // Zero frequency increments
@@ -90,102 +664,546 @@ void GF1Device::clear(int &errcnt, std::string &errstr)
         FSTARTLSB, 0x00, FSTARTMSB, 0x00  // Start frequency set to zero
     };
     cp2130_.spiWrite(clearFrequency, EPOUT, errcnt, errstr);  // Set the waveform to sinusoidal and the frequency to zero (AD5932 on channel 0)
-    usleep(100);  // Wait 100us, in order to prevent possible errors while switching the chip select (workaround)
+    programmed_ = {true, std::chrono::steady_clock::time_point(), 0, 0, 0, 0};  // Keep track of the programmed registers, which take effect on the next toggle of the CTRL signal (since version 1.1.0)
+    waveform_ = WFSINE;
+    waveformKnown_ = true;
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while switching the chip select (workaround)
     cp2130_.selectCS(1, errcnt, errstr);  // Enable the chip select corresponding to channel 1, and again disable the rest (including the one corresponding to the previously enabled channel)
-    usleep(100);  // Wait 100us, in order to prevent possible errors after switching the chip select (workaround implemented in version 1.0.1)
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after switching the chip select (workaround implemented in version 1.0.1)
     std::vector<uint8_t> clearAmplitude = {
         0x00  // Amplitude set to zero
     };
     cp2130_.spiWrite(clearAmplitude, EPOUT, errcnt, errstr);  // Set the amplitude to zero (AD5160 on channel 1)
-    usleep(100);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+    amplitudeCode_ = 0;  // Keep track of the amplitude (since version 1.1.0)
+    amplitudeKnown_ = true;
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
     cp2130_.disableCS(1, errcnt, errstr);  // Disable the chip select corresponding to channel 1, which is the only one that is active to this point
+    cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+    cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+    checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required (since version 1.1.0)
+}
+
+// Requests the cancellation of the long running operation in progress, if any, which then stops at its next boundary (added in version 1.1.0)
+// This applies to stepThrough(), setLeveledSweep(), glide(), playHops() and soak(), which stop before the next point, increment, update, hop or operation and report the cancellation via the "cancelled" field of their statistics, and to the SPI streams of the CP2130 (see CP2130::cancel()). It is meant to be called from another thread
+// If the device is locked (see lock()), the request stands until the device is unlocked, so that it is not lost if made before the operation of the current holder starts. Otherwise, only requests made while the operation is in progress are honored
+void GF1Device::cancel()
+{
+    cancelRequested_ = true;
+    cp2130_.cancel();
+}
+
+// Clears the leveling table (added in version 1.1.0)
+void GF1Device::clearLevelingTable()
+{
+    Access access(*this);
+    leveling_.clear();
+}
+
+// Removes all presets from the preset bank (added in version 1.1.0)
+void GF1Device::clearPresets()
+{
+    Access access(*this);
+    presets_.clear();
 }
 
 // Closes the device safely, if open
 void GF1Device::close()
 {
-    cp2130_.close();
+    Access access(*this);
+    bool release = true;
+    if (shared_) {  // A shared device is only closed once every holder has closed it (see acquire()), so that it is not closed from under the others (since version 1.1.0)
+        std::lock_guard<std::mutex> guard(queueMutex_);
+        release = claims_ <= 1;
+        claims_ = release ? 0 : claims_ - 1;
+    }
+    if (release) {
+        cp2130_.close();
+        forgetState();  // The state of the device is no longer known (since version 1.1.0)
+    }
+}
+
+// Disarms the trigger, without starting the output (added in version 1.1.0)
+void GF1Device::disarmTrigger()
+{
+    Access access(*this);
+    trigger_.armed = false;
+}
+
+// Returns the expected duration (in us) of a given operation, from the moment it is called until it returns (added in version 1.1.0)
+// The estimate is based on the timing model of the CP2130, which accounts for USB transfers and SPI clocking, plus the delays required by the workarounds
+// Note that the operation should be one of the values applicable to estimateDuration() (see "gf1device.h")
+double GF1Device::estimateDuration(uint8_t operation, int &errcnt, std::string &errstr) const
+{
+    double duration;
+    switch (operation) {
+        case OPCLEAR:  // Four control transfers, a 14-byte write to channel 0 and a 1-byte write to channel 1
+            duration = 4 * cp2130_.estimateControlTime() + cp2130_.estimateSPIWriteTime(14, cfrq0_) + cp2130_.estimateSPIWriteTime(1, cfrq1_) + 4 * CS_DELAY;
+            break;
+        case OPSETAMPLITUDE:  // Two control transfers and a 1-byte write to channel 1
+            duration = 2 * cp2130_.estimateControlTime() + cp2130_.estimateSPIWriteTime(1, cfrq1_) + 2 * CS_DELAY;
+            break;
+        case OPSETFREQUENCY:  // Seven control transfers and a 12-byte write to channel 0
+        case OPSETSWEEP:
+            duration = 7 * cp2130_.estimateControlTime() + cp2130_.estimateSPIWriteTime(12, cfrq0_) + 2 * CS_DELAY;
+            break;
+        case OPSETWAVE:  // Five control transfers and a 2-byte write to channel 0
+            duration = 5 * cp2130_.estimateControlTime() + cp2130_.estimateSPIWriteTime(2, cfrq0_) + 2 * CS_DELAY;
+            break;
+        case OPSTART:  // Three control transfers
+        case OPSTOP:
+            duration = 3 * cp2130_.estimateControlTime();
+            break;
+        default:
+            ++errcnt;
+            errstr += "In estimateDuration(): Operation value must be between 0 and 6.\n";  // Program logic error
+            duration = 0;
+    }
+    return duration;
 }
 
 // Returns the silicon version of the CP2130 bridge
 CP2130::SiliconVersion GF1Device::getCP2130SiliconVersion(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
     return cp2130_.getSiliconVersion(errcnt, errstr);
 }
 
 // Returns the hardware revision of the device
 std::string GF1Device::getHardwareRevision(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
     return hardwareRevision(getUSBConfig(errcnt, errstr));
 }
 
+// Returns the idle policy of the CP2130 (added in version 1.1.0)
+CP2130::IdlePolicy GF1Device::getIdlePolicy() const
+{
+    return cp2130_.getIdlePolicy();
+}
+
 // Gets the manufacturer descriptor from the device
 std::u16string GF1Device::getManufacturerDesc(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
     return cp2130_.getManufacturerDesc(errcnt, errstr);
 }
 
+// Returns the operation profiles gathered while profiling was enabled, keyed by function name (added in version 1.1.0)
+// These only cover the operations of this class, while the profiles of the underlying CP2130 operations are kept apart, and can be obtained from the CP2130 class
+std::map<std::string, CP2130::OperationProfile> GF1Device::getOperationProfiles() const
+{
+    return profiler_.getProfiles();
+}
+
 // Gets the product descriptor from the device
 std::u16string GF1Device::getProductDesc(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
     return cp2130_.getProductDesc(errcnt, errstr);
 }
 
 // Gets the serial descriptor from the device
 std::u16string GF1Device::getSerialDesc(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
     return cp2130_.getSerialDesc(errcnt, errstr);
 }
 
+// Returns the scheduler policy used by lock() (added in version 1.1.0)
+GF1Device::SchedulerPolicy GF1Device::getSchedulerPolicy() const
+{
+    std::lock_guard<std::mutex> guard(queueMutex_);
+    return schpolicy_;
+}
+
+// Returns the scheduler statistics, which report the queueing delays per priority class (added in version 1.1.0)
+GF1Device::SchedulerStats GF1Device::getSchedulerStats() const
+{
+    std::lock_guard<std::mutex> guard(queueMutex_);
+    return schstats_;
+}
+
+// Returns the timing model used by estimateDuration() (added in version 1.1.0)
+CP2130::TimingModel GF1Device::getTimingModel() const
+{
+    return cp2130_.getTimingModel();
+}
+
+// Returns the transfer statistics of the device (added in version 1.1.0)
+CP2130::TransferStats GF1Device::getTransferStats() const
+{
+    return cp2130_.getTransferStats();
+}
+
+// Returns the trigger statistics gathered by waitTrigger() (added in version 1.1.0)
+GF1Device::TriggerStats GF1Device::getTriggerStats() const
+{
+    return trgstats_;
+}
+
 // Gets the USB configuration of the device
 CP2130::USBConfig GF1Device::getUSBConfig(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
     return cp2130_.getUSBConfig(errcnt, errstr);
 }
 
+// Returns the watchdog policy of the CP2130 (added in version 1.1.0)
+CP2130::WatchdogPolicy GF1Device::getWatchdogPolicy() const
+{
+    return cp2130_.getWatchdogPolicy();
+}
+
+// Returns the watchdog status of the CP2130 (added in version 1.1.0)
+CP2130::WatchdogStatus GF1Device::getWatchdogStatus() const
+{
+    return cp2130_.getWatchdogStatus();
+}
+
+// Glides the frequency and/or the amplitude linearly from the given start values to the given target values, over the given duration (added in version 1.1.0)
+// Instead of using a fixed number of steps, each update is written as soon as the frequency or amplitude code changes, or as soon as the previous update is done, if the link cannot keep up
+// The latency of each kind of update is measured along the way, and the last update, which sets the target values, is started early enough to end on time
+// The first frequency update writes the full AD5932 frame, with B24 cleared, and later ones only rewrite the Fstart LSBs and/or MSBs registers whose contents changed before toggling CTRL, while amplitude updates only write the AD5160, so that each update takes the cheapest path available
+// Note that the output is restarted at the start frequency if the frequency is to glide, and that the waveform is kept if known (otherwise it is set to sinusoidal)
+GF1Device::GlideStats GF1Device::glide(const Glide &glide, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    GlideStats stats;
+    if (glide.startFrequency < FREQUENCY_MIN || glide.startFrequency > FREQUENCY_MAX || glide.targetFrequency < FREQUENCY_MIN || glide.targetFrequency > FREQUENCY_MAX) {
+        ++errcnt;
+        errstr += "In glide(): Frequencies must be between 0 and 25000.\n";  // Program logic error
+    } else if (glide.startAmplitude < AMPLITUDE_MIN || glide.startAmplitude > AMPLITUDE_MAX || glide.targetAmplitude < AMPLITUDE_MIN || glide.targetAmplitude > AMPLITUDE_MAX) {
+        ++errcnt;
+        errstr += "In glide(): Amplitudes must be between 0 and 5.\n";  // Program logic error
+    } else if (glide.duration <= 0) {
+        ++errcnt;
+        errstr += "In glide(): Duration must be positive.\n";  // Program logic error
+    } else if (glide.startFrequency == glide.targetFrequency && glide.startAmplitude == glide.targetAmplitude) {
+        ++errcnt;
+        errstr += "In glide(): Either the frequency or the amplitude must change.\n";  // Program logic error
+    } else {
+        uint8_t waveform = waveformKnown_ ? waveform_ : WFSINE;
+        bool glideFrequency = glide.startFrequency != glide.targetFrequency;
+        bool glideAmplitude = glide.startAmplitude != glide.targetAmplitude;
+        double fstart = static_cast<double>(glide.startFrequency) * FQUANTUM / MCLK;  // Start and target values, in code units, as per frequencyCode() and amplitudeCode()
+        double ftarget = static_cast<double>(glide.targetFrequency) * FQUANTUM / MCLK;
+        double astart = static_cast<double>(glide.startAmplitude) * AQUANTUM / AMPLITUDE_MAX;
+        double atarget = static_cast<double>(glide.targetAmplitude) * AQUANTUM / AMPLITUDE_MAX;
+        double duration = 1000000 * glide.duration;  // Duration in us
+        uint32_t fcode = 0;
+        uint8_t acode = 0;
+        double flatency = 0;  // Update latency estimates (in us)
+        double alatency = 0;
+        std::vector<uint8_t> fstartFrame;  // Frame that rewrites the Fstart registers, allocated once and refilled with the words that changed at each update
+        fstartFrame.reserve(4);
+        bool first = true;
+        bool last = false;
+        int preverrcnt = errcnt;
+        clearCancel();  // Discard any stale cancellation request
+        std::chrono::steady_clock::time_point start = timeSource().now();
+        while (!last && errcnt == preverrcnt) {  // Stop on the first error
+            if (cancelRequested_) {
+                stats.cancelled = true;
+                break;
+            }
+            double budget = GLD_MARGIN * ((glideFrequency ? flatency : 0) + (glideAmplitude ? alatency : 0));
+            double due = duration - budget;  // Time at which the last update is due, in order to end on time
+            double elapsed = std::chrono::duration<double, std::micro>(timeSource().now() - start).count();
+            last = elapsed >= due;
+            if (!last && elapsed + budget > due) {  // An intermediate update would delay the last one, so the latter is waited for instead
+                timeSource().sleepUntil(start + std::chrono::nanoseconds(static_cast<int64_t>(std::ceil(1000 * due))));
+                continue;
+            }
+            double fraction = last ? 1 : elapsed / duration;
+            uint32_t nextfcode = static_cast<uint32_t>(fstart + (ftarget - fstart) * fraction + 0.5);
+            uint8_t nextacode = static_cast<uint8_t>(astart + (atarget - astart) * fraction + 0.5);
+            bool writeFrequency = glideFrequency && (first || nextfcode != fcode);
+            bool writeAmplitude = glideAmplitude && (first || nextacode != acode);
+            std::chrono::steady_clock::time_point update = timeSource().now();
+            if (writeAmplitude) {  // The amplitude takes effect immediately, so it is written first, in order to coincide with the frequency as much as possible
+                stageAmplitude(nextacode, errcnt, errstr);
+                double latency = std::chrono::duration<double, std::micro>(timeSource().now() - update).count();
+                alatency = first ? latency : alatency + GLD_ALPHA * (latency - alatency);
+                acode = nextacode;
+            }
+            if (writeFrequency) {
+                std::chrono::steady_clock::time_point fupdate = timeSource().now();
+                cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes
+                cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use
+                if (first) {
+                    clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
+                    toggleInterrupt(errcnt, errstr);  // Toggle "INTERRUPT" signal, in order to terminate any sweep in progress
+                    CompiledPreset point = compilePreset(waveform, nextfcode, amplitudeCode_);
+                    point.frequencyFrame[0] &= static_cast<uint8_t>(~B24);  // Clear B24, so that either Fstart register can be rewritten on its own
+                    stageFrequency(point, errcnt, errstr);  // Zero increments, delta frequency and increment interval, and set the waveform and start frequency
+                } else {
+                    fstartFrame.clear();
+                    if ((0x000fff & (nextfcode ^ fcode)) != 0) {  // The 12 LSBs changed
+                        fstartFrame.push_back(static_cast<uint8_t>(FSTARTLSB | (0x0f & nextfcode >> 8)));  // Start frequency (Fstart LSBs register)
+                        fstartFrame.push_back(static_cast<uint8_t>(nextfcode));
+                    }
+                    if ((0xfff000 & (nextfcode ^ fcode)) != 0) {  // The 12 MSBs changed
+                        fstartFrame.push_back(static_cast<uint8_t>(FSTARTMSB | (0x0f & nextfcode >> 20)));  // Start frequency (Fstart MSBs register)
+                        fstartFrame.push_back(static_cast<uint8_t>(nextfcode >> 12));
+                    }
+                    cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
+                    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+                    cp2130_.spiWrite(fstartFrame, EPOUT, errcnt, errstr);  // Set the start frequency (AD5932 on channel 0)
+                    programmed_.start = nextfcode;  // Keep track of the programmed registers
+                    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+                    cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
+                }
+                toggleCtrl(errcnt, errstr);  // Toggle "CTRL" signal, which makes the staged frequency take effect
+                cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+                cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+                double latency = std::chrono::duration<double, std::micro>(timeSource().now() - fupdate).count();
+                flatency = first ? latency : flatency + GLD_ALPHA * (latency - flatency);
+                fcode = nextfcode;
+            }
+            if (writeFrequency || writeAmplitude) {
+                stats.updlat.add(std::chrono::duration<double, std::micro>(timeSource().now() - update).count());
+                ++stats.updates;
+            }
+            first = false;
+            if (!last) {  // Wait until either code is due to change, or until the last update is due, whichever comes first
+                double next = duration - GLD_MARGIN * ((glideFrequency ? flatency : 0) + (glideAmplitude ? alatency : 0));  // The estimates may have changed since the last update was due
+                if (glideFrequency) {
+                    next = std::min(next, duration * ((ftarget > fstart ? fcode + 0.5 : fcode - 0.5) - fstart) / (ftarget - fstart));  // Time at which the frequency code is due to change (rounding flips halfway between codes)
+                }
+                if (glideAmplitude) {
+                    next = std::min(next, duration * ((atarget > astart ? acode + 0.5 : acode - 0.5) - astart) / (atarget - astart));  // Likewise, regarding the amplitude code
+                }
+                timeSource().sleepUntil(start + std::chrono::nanoseconds(static_cast<int64_t>(std::ceil(1000 * next)) + 1));  // Rounded up and past the instant the code flips, since the code does not change exactly at that instant (this also guarantees progress if the virtual clock is in use)
+            }
+        }
+        std::chrono::steady_clock::time_point end = timeSource().now();
+        stats.elapsed = std::chrono::duration<double>(end - start).count();
+        stats.lateness = std::chrono::duration<double, std::micro>(end - start).count() - duration;
+        checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required
+    }
+    return stats;
+}
+
+// Hands the device off to another process over the given Unix domain socket, without disturbing its output (added in version 1.1.0)
+// See CP2130::handOff() for details
+void GF1Device::handOff(int socket, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    cp2130_.handOff(socket, errcnt, errstr);
+    if (!cp2130_.isOpen()) {
+        forgetState();  // The state of the device is no longer known here
+    }
+}
+
+// Waits for exclusive access to the device, as a normal priority operation from the default submitter (added in version 1.1.0)
+// This allows several threads or subsystems holding the same device (see acquire()) to serialize their operations, and can be used via std::lock_guard
+void GF1Device::lock()
+{
+    lock(PRIONORMAL);
+}
+
+// Waits for exclusive access to the device, as an operation of the given priority class, submitted by the given submitter and having the given relative cost (added in version 1.1.0)
+// Submitters are arbitrary identifiers (e.g., one per thread or subsystem), which share the device in proportion to their weights (see setSubmitterWeight()). Invalid priority classes are treated as background
+// Note that access is not preempted as such, but a critical operation cancels any cancellable operation of a lower class that is in progress (see cancel()), so that it only waits until the next segment or step boundary. The preempted operation does not resume, and reports the cancellation as if cancel() had been called
+// The cancellation applies to the current holder as a whole, so that any cancellable operation it starts afterwards, until it unlocks the device, is cancelled as well
+void GF1Device::lock(uint8_t prioclass, uint32_t submitter, double cost)
+{
+    std::unique_lock<std::mutex> guard(queueMutex_);
+    Waiter waiter;
+    waiter.ticket = nextTicket_;  // Take a ticket, and wait until it is served
+    ++nextTicket_;
+    waiter.prioclass = prioclass > PRIOBACKGROUND ? PRIOBACKGROUND : prioclass;
+    std::map<uint32_t, double>::const_iterator weight = submitterWeights_.find(submitter);
+    double &finish = submitterFinish_[submitter];
+    finish = std::max(queueVirtual_, finish) + std::max(cost, 0.0) / (weight == submitterWeights_.end() ? 1 : weight->second);  // Virtual finish time, as per self-clocked fair queuing
+    waiter.finish = finish;
+    waiter.arrival = timeSource().now();
+    waiters_.push_back(waiter);
+    bool preempt = false;
+    if (!queueBusy_) {
+        serveNext();
+    } else if (waiter.prioclass == PRIOCRITICAL && servingClass_ != PRIOCRITICAL) {  // A critical operation preempts any long running operation of a lower class at its next boundary (since version 1.1.0)
+        cancelRequested_ = true;  // Set under the queue mutex, so that the request is tied to the current holder, even if its operation has yet to start
+        preempt = true;
+    }
+    uint64_t ticket = waiter.ticket;
+    if (preempt) {  // Any SPI stream of the CP2130 is cancelled as well, which may cancel a transfer in flight, and is therefore not done while holding the queue mutex
+        guard.unlock();
+        cp2130_.cancel();
+        guard.lock();
+    }
+    queueCond_.wait(guard, [this, ticket] {return servingTicket_ == ticket && queueBusy_;});
+    holder_ = std::this_thread::get_id();  // Operations of a shared device called by the holder are not queued again (see Access)
+}
+
 // Opens a device and assigns its handle
-int GF1Device::open(const std::string &serial)
+// Since version 1.1.0, the backend can be specified as well (see CP2130::open() for details)
+int GF1Device::open(const std::string &serial, uint8_t backend)
+{
+    Access access(*this);
+    int retval = cp2130_.open(VID, PID, serial, backend);
+    if (retval == SUCCESS) {
+        forgetState();  // The registers of a freshly opened device are unknown, and so is its output (since version 1.1.0)
+    }
+    return retval;
+}
+
+// Opens the device via the given transport, such as an EmulatorTransport, which allows for simulating the device (added in version 1.1.0)
+// The transport must remain valid until the device is closed
+int GF1Device::openTransport(CP2130::Transport *transport)
+{
+    Access access(*this);
+    int retval = cp2130_.openTransport(transport);
+    if (retval == SUCCESS) {
+        forgetState();
+    }
+    return retval;
+}
+
+// Returns the number of presets in the preset bank (added in version 1.1.0)
+size_t GF1Device::presetCount() const
+{
+    return presets_.size();
+}
+
+// Recalls the preset having the given index, by submitting the frames that were compiled when the preset was added (added in version 1.1.0)
+// If "diff" is true, the frames are compared against the known state of the device, and only the parts that differ are written
+// Moreover, the "CTRL" signal is only toggled if the AD5932 registers were written, or if the output is not known to be generated
+void GF1Device::recallPreset(size_t index, bool diff, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    if (index >= presets_.size()) {
+        ++errcnt;
+        errstr += "In recallPreset(): Preset index is out of range.\n";  // Program logic error
+    } else {
+        cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes
+        cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use (since version 1.1.0)
+        if (stagePreset(presets_[index], diff, false, errcnt, errstr)) {  // Write the frames of the preset, and toggle "CTRL" if required
+            toggleCtrl(errcnt, errstr);  // Toggle "CTRL" signal
+        }
+        cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+        cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+        checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required (since version 1.1.0)
+    }
+}
+
+// Recovers a misbehaving device, by resetting and reopening it via CP2130::recover(), and then restoring its state (added in version 1.1.0)
+// The SPI channels are set up again, and the waveform, frequency and amplitude are rewritten if known, restarting the output if it was being generated
+// A sweep in progress is not resumed, since its timeline cannot be restored. Instead, the output is held at the frequency reached by the sweep
+// Returns the same values as open()
+int GF1Device::recover(int &errcnt, std::string &errstr)
 {
-    return cp2130_.open(VID, PID, serial);
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    uint8_t cfrq0 = cfrq0_;  // Take a snapshot of the known state, which is lost once the device is reset
+    uint8_t cfrq1 = cfrq1_;
+    bool frequencyKnown = waveformKnown_ && programmed_.active;
+    bool amplitudeKnown = amplitudeKnown_;
+    bool outputActive = timeline_.active;
+    uint8_t waveform = waveform_;
+    uint8_t amplitude = amplitudeCode_;
+    uint32_t frequency = outputActive ? frequencyCode(instantaneousFrequency()) : programmed_.start;
+    int retval = cp2130_.recover(errcnt, errstr);
+    forgetState();
+    if (retval == SUCCESS) {
+        setupChannel0(cfrq0, errcnt, errstr);
+        setupChannel1(cfrq1, errcnt, errstr);
+        cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes
+        cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use
+        if (frequencyKnown && amplitudeKnown) {
+            stagePreset(compilePreset(waveform, frequency, amplitude), false, true, errcnt, errstr);  // Write the waveform, frequency and amplitude in one go
+            if (outputActive) {
+                toggleCtrl(errcnt, errstr);  // Restart the output
+            }
+        } else if (amplitudeKnown) {
+            stageAmplitude(amplitude, errcnt, errstr);  // Restore the amplitude
+        }
+        cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+        cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+    }
+    return retval;
 }
 
 // Issues a reset to the CP2130, which in effect resets the entire device
 void GF1Device::reset(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
     cp2130_.reset(errcnt, errstr);
+    forgetState();  // The state of the device is no longer known (since version 1.1.0)
+}
+
+// Discards the operation profiles (added in version 1.1.0)
+void GF1Device::resetOperationProfiles()
+{
+    profiler_.reset();
+}
+
+// Resets the scheduler statistics (added in version 1.1.0)
+void GF1Device::resetSchedulerStats()
+{
+    std::lock_guard<std::mutex> guard(queueMutex_);
+    schstats_ = SchedulerStats();
+}
+
+// Resets the transfer statistics of the device (added in version 1.1.0)
+void GF1Device::resetTransferStats()
+{
+    cp2130_.resetTransferStats();
+}
+
+// Resets the trigger statistics (added in version 1.1.0)
+void GF1Device::resetTriggerStats()
+{
+    Access access(*this);
+    trgstats_ = TriggerStats();
+}
+
+// Resets the watchdog of the CP2130, clearing its baselines and counters (added in version 1.1.0)
+void GF1Device::resetWatchdog()
+{
+    cp2130_.resetWatchdog();
 }
 
 // Sets the amplitude of the generated signal to the given value (in Vpp)
 void GF1Device::setAmplitude(float amplitude, int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
     if (amplitude < AMPLITUDE_MIN || amplitude > AMPLITUDE_MAX) {
         ++errcnt;
         errstr += "In setAmplitude(): Amplitude must be between 0 and 5.\n";  // Program logic error
     } else {
-        cp2130_.selectCS(1, errcnt, errstr);  // Enable the chip select corresponding to channel 1, and disable any others
-        usleep(100);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
-        uint8_t amplitudeCode = static_cast<uint8_t>(amplitude * AQUANTUM / AMPLITUDE_MAX + 0.5);
-        std::vector<uint8_t> setAmplitude = {
-            amplitudeCode  // Amplitude
-        };
-        cp2130_.spiWrite(setAmplitude, EPOUT, errcnt, errstr);  // Set the amplitude of the output signal (AD5160 on channel 1)
-        usleep(100);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
-        cp2130_.disableCS(1, errcnt, errstr);  // Disable the previously enabled chip select
+        stageAmplitude(amplitudeCode(amplitude), errcnt, errstr);  // Set the amplitude of the output signal, keeping track of it (since version 1.1.0)
+        checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required (since version 1.1.0)
     }
 }
 
 // Sets the frequency of the generated signal to the given value (in KHz)
 void GF1Device::setFrequency(float frequency, int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
     if (frequency < FREQUENCY_MIN || frequency > FREQUENCY_MAX) {
         ++errcnt;
         errstr += "In setFrequency(): Frequency must be between 0 and 25000.\n";  // Program logic error
     } else {
+        cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes (since version 1.1.0)
+        cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use (since version 1.1.0)
         clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
         toggleInterrupt(errcnt, errstr);  // Toggle "INTERRUPT" signal (this toggle is not really necessary, unless the frequency increments are set to be externally triggered via GPIO.2/CTRL)
         cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
-        usleep(100);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
-        uint32_t frequencyCode = static_cast<uint32_t>(frequency * FQUANTUM / MCLK + 0.5);
+        timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+        uint32_t frequencyCode = GF1Device::frequencyCode(frequency);
         std::vector<uint8_t> setFrequency = {
             0x10, 0x00,                                                      // Zero frequency increments
             0x20, 0x00, 0x30, 0x00,                                          // Delta frequency set to zero
@@ -196,78 +1214,671 @@ void GF1Device::setFrequency(float frequency, int &errcnt, std::string &errstr)
             static_cast<uint8_t>(frequencyCode >> 12)
         };
         cp2130_.spiWrite(setFrequency, EPOUT, errcnt, errstr);  // Set the frequency of the output signal by updating the above registers (AD5932 on channel 0)
-        usleep(100);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+        programmed_ = {true, std::chrono::steady_clock::time_point(), frequencyCode, 0, 0, 0};  // Keep track of the programmed registers (since version 1.1.0)
+        timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
         cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
         toggleCtrl(errcnt, errstr);  // Toggle "CTRL" signal
+        cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+        cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+        checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required (since version 1.1.0)
     }
 }
 
+// Sets the idle policy of the CP2130, which guards against the latency of the first transfer after an idle period (added in version 1.1.0)
+void GF1Device::setIdlePolicy(const CP2130::IdlePolicy &policy, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    cp2130_.setIdlePolicy(policy, errcnt, errstr);
+}
+
+// Sets up and starts a sweep, as setSweep() does, while keeping the amplitude in line with the leveling table for the whole duration of the sweep (added in version 1.1.0)
+// The amplitude codes of every increment are computed beforehand, and only 1-byte writes to the AD5160 take place while the AD5932 steps the frequency in hardware, following the timeline of the sweep
+// Each write takes a couple of transfers plus the chip select delays, so if an increment is due before the update to the previous one is written, the latter is skipped. Thus, the function blocks until the sweep is complete
+GF1Device::LevelingStats GF1Device::setLeveledSweep(const Sweep &sweep, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    LevelingStats stats;
+    std::string error = sweepError(sweep);  // The sweep is validated before anything is written, so that the amplitude is left untouched if it is invalid
+    if (!error.empty()) {
+        ++errcnt;
+        errstr += "In setLeveledSweep(): " + error;  // Program logic error
+    } else if (leveling_.empty()) {
+        ++errcnt;
+        errstr += "In setLeveledSweep(): Leveling table is empty.\n";  // Program logic error
+    } else {
+        int64_t startCode = static_cast<int64_t>(std::round(sweep.start * FQUANTUM / MCLK));  // Same codes as the ones computed by setSweep()
+        int32_t deltaCode = static_cast<int32_t>(std::round(sweep.delta * FQUANTUM / MCLK));
+        std::vector<uint8_t> codes(static_cast<size_t>(sweep.nincr) + 1);
+        for (size_t i = 0; i < codes.size(); ++i) {  // Compute the amplitude code for the start frequency and for each increment
+            float amplitude = leveledAmplitude(static_cast<float>((startCode + static_cast<int64_t>(i) * deltaCode) * MCLK / FQUANTUM));
+            codes[i] = amplitudeCode(std::min(std::max(amplitude, AMPLITUDE_MIN), AMPLITUDE_MAX));
+        }
+        int preverrcnt = errcnt;
+        clearCancel();  // Discard any stale cancellation request
+        if (!amplitudeKnown_ || amplitudeCode_ != codes[0]) {  // The amplitude for the start frequency is set before the sweep starts
+            stageAmplitude(codes[0], errcnt, errstr);
+            ++stats.updates;
+        }
+        setSweep(sweep, errcnt, errstr);
+        size_t i = 1;
+        while (i < codes.size() && errcnt == preverrcnt) {  // Stop on the first error
+            if (cancelRequested_) {  // The sweep itself goes on, but without leveling
+                stats.cancelled = true;
+                break;
+            }
+            if (!timeline_.active || timeline_.nincr != sweep.nincr || timeline_.tint <= 0) {  // The output no longer follows the sweep, as it would be if the watchdog recovered the device within setSweep()
+                stats.interrupted = true;
+                break;
+            }
+            std::chrono::steady_clock::time_point due = timeline_.anchor + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::micro>(i * timeline_.tint));
+            timeSource().sleepUntil(due);  // Wait for the increment to take place
+            double elapsed = std::chrono::duration<double, std::micro>(timeSource().now() - timeline_.anchor).count();
+            size_t current = std::min(static_cast<size_t>(elapsed / timeline_.tint), codes.size() - 1);
+            if (current > i) {  // Skip any increments that are already over
+                stats.skipped += current - i;
+                i = current;
+                due = timeline_.anchor + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::micro>(i * timeline_.tint));
+            }
+            if (amplitudeCode_ != codes[i]) {  // Consecutive increments often share the same code, in which case nothing is written
+                stageAmplitude(codes[i], errcnt, errstr);
+                stats.lateness.add(std::chrono::duration<double, std::micro>(timeSource().now() - due).count());
+                ++stats.updates;
+            }
+            ++i;
+        }
+        checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required
+    }
+    return stats;
+}
+
+// Sets the leveling table used by setLeveledSweep(), which maps frequencies to the amplitudes that compensate for the response of the output path (added in version 1.1.0)
+// The points must be sorted by strictly increasing frequency, and amplitudes are interpolated linearly between them
+void GF1Device::setLevelingTable(const std::vector<LevelingPoint> &table, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    bool sorted = true;
+    bool inRange = true;
+    for (size_t i = 0; i < table.size(); ++i) {
+        sorted = sorted && (i == 0 || table[i].frequency > table[i - 1].frequency);
+        inRange = inRange && table[i].frequency >= FREQUENCY_MIN && table[i].frequency <= FREQUENCY_MAX && table[i].amplitude >= AMPLITUDE_MIN && table[i].amplitude <= AMPLITUDE_MAX;
+    }
+    if (table.empty()) {
+        ++errcnt;
+        errstr += "In setLevelingTable(): Leveling table must have at least one point.\n";  // Program logic error
+    } else if (!sorted) {
+        ++errcnt;
+        errstr += "In setLevelingTable(): Frequencies must be strictly increasing.\n";  // Program logic error
+    } else if (!inRange) {
+        ++errcnt;
+        errstr += "In setLevelingTable(): Frequencies must be between 0 and 25000, and amplitudes must be between 0 and 5.\n";  // Program logic error
+    } else {
+        leveling_ = table;
+    }
+}
+
+// Enables or disables profiling of the operations of this class, which works as in the CP2130 class (added in version 1.1.0)
+// The transfers and bytes of each operation cover every CP2130 operation it issued, and the wall-clock time of operations such as stepThrough() also includes the time spent in callbacks
+void GF1Device::setProfiling(bool enabled)
+{
+    profiler_.setEnabled(enabled);
+}
+
+// Sets the scheduler policy used by lock(), which sets the queueing delay targets of each priority class (added in version 1.1.0)
+void GF1Device::setSchedulerPolicy(const SchedulerPolicy &policy)
+{
+    std::lock_guard<std::mutex> guard(queueMutex_);
+    schpolicy_ = policy;
+}
+
 // Sets the waveform of the generated signal to sinusoidal
 void GF1Device::setSineWave(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes (since version 1.1.0)
+    cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use (since version 1.1.0)
     clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
     cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
-    usleep(100);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
     std::vector<uint8_t> setSineWave = {
         0x0f, 0xdf  // Sinusoidal waveform, automatic increments, MSBOUT pin enabled, SYNCOUT pin enabled, B24 = 1, SYNCSEL = 1
     };
     cp2130_.spiWrite(setSineWave, EPOUT, errcnt, errstr);  // Set the waveform to sinusoidal (AD5932 on channel 0)
-    usleep(100);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+    waveform_ = WFSINE;  // Keep track of the waveform (since version 1.1.0)
+    waveformKnown_ = true;
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
     cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
     toggleCtrl(errcnt, errstr);  // Toggle "CTRL" signal
+    cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+    cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+    checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required (since version 1.1.0)
+}
+
+// Sets the weight of the given submitter, which gets a share of the device proportional to it, relative to other submitters of the same priority class (added in version 1.1.0)
+// Submitters that were never given a weight have a weight of one
+void GF1Device::setSubmitterWeight(uint32_t submitter, double weight, int &errcnt, std::string &errstr)
+{
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    if (weight <= 0) {
+        ++errcnt;
+        errstr += "In setSubmitterWeight(): Weight must be greater than zero.\n";  // Program logic error
+    } else {
+        std::lock_guard<std::mutex> guard(queueMutex_);
+        submitterWeights_[submitter] = weight;
+    }
+}
+
+// Programs and starts a frequency sweep, which is carried out by the AD5932 waveform generator without further intervention (added in version 1.1.0)
+// The output starts at the given start frequency, and the delta frequency is added at each increment, until the number of increments is reached
+// The final frequency is then held, and the progress of the sweep can be followed via frequencyAt() or instantaneousFrequency()
+void GF1Device::setSweep(const Sweep &sweep, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    std::string error = sweepError(sweep);  // The sweep parameters are validated by a helper function, which is shared with setLeveledSweep() (since version 1.1.0)
+    if (!error.empty()) {
+        ++errcnt;
+        errstr += "In setSweep(): " + error;  // Program logic error
+    } else {
+        int64_t startCode = static_cast<int64_t>(std::round(sweep.start * FQUANTUM / MCLK));
+        int32_t deltaCode = static_cast<int32_t>(std::round(sweep.delta * FQUANTUM / MCLK));
+        cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes (since version 1.1.0)
+        cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use (since version 1.1.0)
+        clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
+        toggleInterrupt(errcnt, errstr);  // Toggle "INTERRUPT" signal, in order to terminate any sweep in progress
+        cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
+        timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+        uint32_t deltaMagnitude = static_cast<uint32_t>(deltaCode < 0 ? -deltaCode : deltaCode);
+        std::vector<uint8_t> setSweep = {
+            static_cast<uint8_t>(NINCR | (0x0f & sweep.nincr >> 8)),                                             // Number of increments
+            static_cast<uint8_t>(sweep.nincr),
+            static_cast<uint8_t>(DFLSB | (0x0f & deltaMagnitude >> 8)),                                           // Delta frequency (delta frequency LSBs register)
+            static_cast<uint8_t>(deltaMagnitude),
+            static_cast<uint8_t>(DFMSB | (deltaCode < 0 ? DFNEG : 0x00) | (0x07 & deltaMagnitude >> 20)),        // Delta frequency, including its sign (delta frequency MSBs register)
+            static_cast<uint8_t>(deltaMagnitude >> 12),
+            static_cast<uint8_t>(TINT | TINTMCLK | (0x03 & sweep.tintmult) << 3 | (0x07 & sweep.tint >> 8)),  // Increment interval, given in MCLK periods
+            static_cast<uint8_t>(sweep.tint),
+            static_cast<uint8_t>(FSTARTLSB | (0x0f & startCode >> 8)),                                          // Start frequency (Fstart LSBs register)
+            static_cast<uint8_t>(startCode),
+            static_cast<uint8_t>(FSTARTMSB | (0x0f & startCode >> 20)),                                         // Start frequency (Fstart MSBs register)
+            static_cast<uint8_t>(startCode >> 12)
+        };
+        cp2130_.spiWrite(setSweep, EPOUT, errcnt, errstr);  // Program the sweep by updating the above registers (AD5932 on channel 0)
+        programmed_ = {true, std::chrono::steady_clock::time_point(), static_cast<uint32_t>(startCode), deltaCode, sweep.nincr, sweepDuration(sweep) / sweep.nincr};  // Keep track of the programmed registers
+        timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+        cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
+        toggleCtrl(errcnt, errstr);  // Toggle "CTRL" signal, which starts the sweep and anchors its timeline
+        cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+        cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+        checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required (since version 1.1.0)
+    }
+}
+
+// Sets the timing model used by estimateDuration(), in alternative to calibrateTimingModel() (added in version 1.1.0)
+void GF1Device::setTimingModel(const CP2130::TimingModel &model)
+{
+    Access access(*this);
+    cp2130_.setTimingModel(model);
 }
 
 // Sets the waveform of the generated signal to triangular
 void GF1Device::setTriangleWave(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes (since version 1.1.0)
+    cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use (since version 1.1.0)
     clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
     cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
-    usleep(100);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors after enabling the chip select (workaround implemented in version 1.0.1)
     std::vector<uint8_t> setTriangleWave = {
         0x0d, 0xdf  // Triangular waveform, automatic increments, MSBOUT pin enabled, SYNCOUT pin enabled, B24 = 1, SYNCSEL = 1
     };
     cp2130_.spiWrite(setTriangleWave, EPOUT, errcnt, errstr);  // Set the waveform to triangular (AD5932 on channel 0)
-    usleep(100);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+    waveform_ = WFTRIANGLE;  // Keep track of the waveform (since version 1.1.0)
+    waveformKnown_ = true;
+    timeSource().sleep(CS_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
     cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
     toggleCtrl(errcnt, errstr);  // Toggle "CTRL" signal
+    cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+    cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+    checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required (since version 1.1.0)
+}
+
+// Sets the watchdog policy of the CP2130 (added in version 1.1.0)
+// If the policy calls for proactive recovery, recover() is called at the end of any operation that changes the output, once the watchdog trips
+void GF1Device::setWatchdogPolicy(const CP2130::WatchdogPolicy &policy)
+{
+    cp2130_.setWatchdogPolicy(policy);
+}
+
+// Sets up channel 0 for communication with the AD5932 waveform generator, using the given SPI clock frequency (added in version 1.1.0)
+void GF1Device::setupChannel0(uint8_t cfrq, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    if (cfrq > CP2130::CFRQ938) {
+        ++errcnt;
+        errstr += "In setupChannel0(): Clock frequency value must be between 0 and 7.\n";  // Program logic error
+    } else {
+        CP2130::SPIMode mode;
+        mode.csmode = CP2130::CSMODEPP;  // Chip select pin mode regarding channel 0 is push-pull
+        mode.cfrq = cfrq;  // SPI clock frequency set to the given value
+        mode.cpol = CP2130::CPOL1;  // SPI clock polarity is active low (CPOL = 1)
+        mode.cpha = CP2130::CPHA0;  // SPI data is valid on each falling edge (CPHA = 0)
+        cp2130_.configureSPIMode(0, mode, errcnt, errstr);  // Configure SPI mode for channel 0, using the above settings
+        cp2130_.disableSPIDelays(0, errcnt, errstr);  // Disable all SPI delays for channel 0
+        cfrq0_ = cfrq;  // Keep track of the clock frequency, as required by estimateDuration()
+    }
 }
 
-// Sets up channel 0 for communication with the AD5932 waveform generator
+// Sets up channel 0 for communication with the AD5932 waveform generator, with the SPI clock frequency set to 12MHz
 void GF1Device::setupChannel0(int &errcnt, std::string &errstr)
 {
-    CP2130::SPIMode mode;
-    mode.csmode = CP2130::CSMODEPP;  // Chip select pin mode regarding channel 0 is push-pull
-    mode.cfrq = CP2130::CFRQ12M;  // SPI clock frequency set to 12MHz
-    mode.cpol = CP2130::CPOL1;  // SPI clock polarity is active low (CPOL = 1)
-    mode.cpha = CP2130::CPHA0;  // SPI data is valid on each falling edge (CPHA = 0)
-    cp2130_.configureSPIMode(0, mode, errcnt, errstr);  // Configure SPI mode for channel 0, using the above settings
-    cp2130_.disableSPIDelays(0, errcnt, errstr);  // Disable all SPI delays for channel 0
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    setupChannel0(CP2130::CFRQ12M, errcnt, errstr);
 }
 
-// Sets up channel 1 for communication with the AD5160 SPI potentiometer
+// Sets up channel 1 for communication with the AD5160 SPI potentiometer, using the given SPI clock frequency (added in version 1.1.0)
+void GF1Device::setupChannel1(uint8_t cfrq, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    if (cfrq > CP2130::CFRQ938) {
+        ++errcnt;
+        errstr += "In setupChannel1(): Clock frequency value must be between 0 and 7.\n";  // Program logic error
+    } else {
+        CP2130::SPIMode mode;
+        mode.csmode = CP2130::CSMODEPP;  // Chip select pin mode regarding channel 1 is push-pull
+        mode.cfrq = cfrq;  // SPI clock frequency set to the given value
+        mode.cpol = CP2130::CPOL0;  // SPI clock polarity is active high (CPOL = 0)
+        mode.cpha = CP2130::CPHA0;  // SPI data is valid on each rising edge (CPHA = 0)
+        cp2130_.configureSPIMode(1, mode, errcnt, errstr);  // Configure SPI mode for channel 1, using the above settings
+        cp2130_.disableSPIDelays(1, errcnt, errstr);  // Disable all SPI delays for channel 1
+        cfrq1_ = cfrq;  // Keep track of the clock frequency, as required by estimateDuration()
+    }
+}
+
+// Sets up channel 1 for communication with the AD5160 SPI potentiometer, with the SPI clock frequency set to 12MHz
 void GF1Device::setupChannel1(int &errcnt, std::string &errstr)
 {
-    CP2130::SPIMode mode;
-    mode.csmode = CP2130::CSMODEPP;  // Chip select pin mode regarding channel 1 is push-pull
-    mode.cfrq = CP2130::CFRQ12M;  // SPI clock frequency set to 12MHz
-    mode.cpol = CP2130::CPOL0;  // SPI clock polarity is active high (CPOL = 0)
-    mode.cpha = CP2130::CPHA0;  // SPI data is valid on each rising edge (CPHA = 0)
-    cp2130_.configureSPIMode(1, mode, errcnt, errstr);  // Configure SPI mode for channel 1, using the above settings
-    cp2130_.disableSPIDelays(1, errcnt, errstr);  // Disable all SPI delays for channel 1
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    setupChannel1(CP2130::CFRQ12M, errcnt, errstr);
+}
+
+// Drives the device through the given number of pseudo-random operations, in order to expose long-run degradation, such as memory growth or latency drift (added in version 1.1.0)
+// The operations are mixed between setFrequency(), setAmplitude(), setSineWave(), setTriangleWave(), setSweep(), recallPreset() (if any presets were added), start(), stop() and clear(), and each one is timed
+// Every "interval" operations, a sample is taken, holding the resident set size, the transfer buffer growths, the heap allocations and the latency percentiles of the interval, and drift is flagged against the first sample
+// Heap allocations are only counted if the policy sets "alloccounter", since that requires the application to replace the global operator new (the transfer buffer growths alone cannot reveal allocations made elsewhere, such as those of SPI frames)
+// Each sample is passed to the given report function, if any, which should return false in order to stop early. The run also stops once cancel() is called
+// Failed operations are counted and the run goes on, but only the first failure is reported via "errcnt" and "errstr", so that these do not grow over long runs
+GF1Device::SoakStats GF1Device::soak(const SoakPolicy &policy, const std::function<bool(const SoakSample &sample)> &report, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    SoakStats stats;
+    if (policy.interval == 0) {
+        ++errcnt;
+        errstr += "In soak(): Interval must be positive.\n";  // Program logic error
+    } else if (policy.rssdrift < 0 || policy.bufdrift < 0 || policy.allocdrift < 0 || policy.latdrift < 0) {
+        ++errcnt;
+        errstr += "In soak(): Drift thresholds must be non-negative.\n";  // Program logic error
+    } else {
+        std::minstd_rand random(policy.seed);
+        int errcntOp;  // Each operation reports to its own error variables, which are cleared in between (the string keeps its capacity)
+        std::string errstrOp;
+        CP2130::LatencyStats interval;  // Latency statistics of the current interval
+        uint64_t errors = 0;  // Number of failed operations in the current interval
+        uint64_t bufallocs = cp2130_.getTransferStats().allocs;
+        uint64_t heapallocs = policy.alloccounter ? policy.alloccounter() : 0;
+        bool proceed = true;
+        clearCancel();  // Discard any stale cancellation request
+        std::chrono::steady_clock::time_point begin = timeSource().now();
+        while (stats.operations < policy.operations && proceed) {
+            if (cancelRequested_) {
+                stats.cancelled = true;
+                break;
+            }
+            errcntOp = 0;
+            errstrOp.clear();
+            uint32_t kind = static_cast<uint32_t>(random() % SOAK_KINDS);
+            uint32_t value = static_cast<uint32_t>(random());
+            std::chrono::steady_clock::time_point opstart = timeSource().now();
+            switch (kind) {
+                case 0:
+                    setFrequency(static_cast<float>(value % 2500001) / 100, errcntOp, errstrOp);  // Frequency between 0 and 25000KHz, in 10Hz steps
+                    break;
+                case 1:
+                    setAmplitude(static_cast<float>(value % 501) / 100, errcntOp, errstrOp);  // Amplitude between 0 and 5Vpp, in 10mV steps
+                    break;
+                case 2:
+                    if (value % 2 == 0) {
+                        setSineWave(errcntOp, errstrOp);
+                    } else {
+                        setTriangleWave(errcntOp, errstrOp);
+                    }
+                    break;
+                case 3:
+                    setSweep({static_cast<float>(value % 20001), static_cast<float>(value % 101) / 10, static_cast<uint16_t>(NINCR_MIN + value % 100), static_cast<uint16_t>(TINT_MIN + value % 100), TINTMULT1}, errcntOp, errstrOp);  // Short upward sweeps, which never go beyond 21000KHz
+                    break;
+                case 4:
+                    if (presets_.empty()) {
+                        start(errcntOp, errstrOp);
+                    } else {
+                        recallPreset(value % presets_.size(), value % 2 == 0, errcntOp, errstrOp);
+                    }
+                    break;
+                case 5:
+                    start(errcntOp, errstrOp);
+                    break;
+                case 6:
+                    stop(errcntOp, errstrOp);
+                    break;
+                default:
+                    clear(errcntOp, errstrOp);
+            }
+            double latency = std::chrono::duration<double, std::micro>(timeSource().now() - opstart).count();
+            interval.add(latency);
+            stats.latency.add(latency);
+            ++stats.operations;
+            if (errcntOp != 0) {
+                if (stats.errors == 0) {  // Only the first failure is reported
+                    errcnt += errcntOp;
+                    errstr += errstrOp;
+                }
+                ++stats.errors;
+                ++errors;
+            }
+            if (stats.operations % policy.interval == 0 || stats.operations == policy.operations) {  // Take a sample at the end of each interval, and at the end of the run
+                SoakSample sample;
+                sample.operations = stats.operations;
+                sample.elapsed = std::chrono::duration<double>(timeSource().now() - begin).count();
+                sample.rss = residentSetSize();
+                uint64_t totalBufallocs = cp2130_.getTransferStats().allocs;
+                sample.bufallocs = totalBufallocs >= bufallocs ? totalBufallocs - bufallocs : totalBufallocs;  // The transfer statistics may have been reset meanwhile
+                bufallocs = totalBufallocs;
+                if (policy.alloccounter) {
+                    uint64_t totalHeapallocs = policy.alloccounter();
+                    sample.heapallocs = totalHeapallocs - heapallocs;
+                    heapallocs = totalHeapallocs;
+                } else {
+                    sample.heapallocs = 0;
+                }
+                sample.errors = errors;
+                sample.p50 = interval.percentile(0.5);
+                sample.p99 = interval.percentile(0.99);
+                sample.max = interval.max;
+                if (stats.operations <= policy.interval) {  // The first sample is the baseline
+                    sample.drift = false;
+                    stats.baseline = sample;
+                } else {
+                    double baselineAllocs = static_cast<double>(stats.baseline.heapallocs) / stats.baseline.operations;  // Heap allocations per operation over the first interval
+                    sample.drift = sample.rss > stats.baseline.rss + policy.rssdrift || sample.bufallocs > policy.bufdrift * interval.count || sample.heapallocs > (baselineAllocs + policy.allocdrift) * interval.count || sample.p99 > policy.latdrift * stats.baseline.p99;
+                }
+                if (sample.drift) {
+                    ++stats.drifts;
+                }
+                stats.last = sample;
+                interval = CP2130::LatencyStats();
+                errors = 0;
+                if (report) {
+                    proceed = report(sample);
+                }
+            }
+        }
+    }
+    return stats;
 }
 
 // Starts the signal generation
 void GF1Device::start(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes (since version 1.1.0)
+    cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use (since version 1.1.0)
     clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
     toggleCtrl(errcnt, errstr);  // Toggle "CTRL" signal
+    cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+    cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+    checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required (since version 1.1.0)
+}
+
+// Steps the output through the given list of frequencies (in KHz), calling the given acquisition function once each point is generated (added in version 1.1.0)
+// The acquisition function receives the index and frequency of the current point, and should return false in order to stop early. It must not use this object
+// All frames are encoded beforehand, and the next point is staged by a worker thread while the current one is being acquired, so that each step only requires the CTRL toggle
+// The waveform is kept if known (otherwise it is set to sinusoidal), and the amplitude is left as is. Settling delays, if any, should be part of the acquisition function
+// Returns the statistics of the run, including the achieved rate in points per second
+GF1Device::StepStats GF1Device::stepThrough(const std::vector<float> &frequencies, const std::function<bool(size_t index, float frequency)> &acquire, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    StepStats stats;
+    bool valid = true;
+    for (float frequency : frequencies) {
+        valid = valid && frequency >= FREQUENCY_MIN && frequency <= FREQUENCY_MAX;
+    }
+    if (!valid) {
+        ++errcnt;
+        errstr += "In stepThrough(): Frequencies must be between 0 and 25000.\n";  // Program logic error
+    } else if (!frequencies.empty()) {
+        uint8_t waveform = waveformKnown_ ? waveform_ : WFSINE;
+        std::vector<CompiledPreset> points;
+        points.reserve(frequencies.size());
+        for (float frequency : frequencies) {  // Pre-encode every point, so that no encoding takes place while stepping
+            points.push_back(compilePreset(waveform, frequencyCode(frequency), amplitudeCode_));
+        }
+        cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes
+        cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use
+        clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
+        toggleInterrupt(errcnt, errstr);  // Toggle "INTERRUPT" signal, in order to terminate any sweep in progress
+        stageFrequency(points[0], errcnt, errstr);  // Stage the first point
+        cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+        cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+        std::mutex mutex;  // The worker only touches the device while the acquisition function runs, and is always waited for before the next step
+        std::condition_variable condition;
+        size_t staging = 0;  // Index of the point to be staged by the worker (zero if there is none, since the first point is staged above)
+        bool quit = false;
+        int errcntWorker = 0;
+        std::string errstrWorker;
+        std::thread worker([&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                condition.wait(lock, [&] {return staging != 0 || quit;});
+                if (quit) {
+                    break;
+                }
+                lock.unlock();
+                std::chrono::steady_clock::time_point start = timeSource().now();
+                stageFrequency(points[staging], errcntWorker, errstrWorker);
+                stats.stagelat.add(std::chrono::duration<double, std::micro>(timeSource().now() - start).count());
+                lock.lock();
+                staging = 0;
+                condition.notify_all();
+            }
+        });
+        int preverrcnt = errcnt;
+        clearCancel();  // Discard any stale cancellation request
+        std::chrono::steady_clock::time_point start = timeSource().now();
+        for (size_t i = 0; i < points.size() && errcnt == preverrcnt && errcntWorker == 0; ++i) {  // Stop on the first error
+            if (cancelRequested_) {
+                stats.cancelled = true;
+                break;
+            }
+            std::chrono::steady_clock::time_point step = timeSource().now();
+            cp2130_.beginGPIOBatch();
+            toggleCtrl(errcnt, errstr);  // Toggle "CTRL" signal, which makes the staged point take effect
+            cp2130_.endGPIOBatch(errcnt, errstr);
+            stats.steplat.add(std::chrono::duration<double, std::micro>(timeSource().now() - step).count());
+            if (i + 1 < points.size()) {  // Hand the next point over to the worker
+                std::lock_guard<std::mutex> lock(mutex);
+                staging = i + 1;
+                condition.notify_all();
+            }
+            bool proceed = acquire(i, frequencies[i]);
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&] {return staging == 0;});  // Wait for the next point to be staged
+            }
+            ++stats.points;
+            if (!proceed) {
+                break;
+            }
+        }
+        stats.elapsed = std::chrono::duration<double>(timeSource().now() - start).count();
+        stats.rate = stats.elapsed > 0 ? stats.points / stats.elapsed : 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+            condition.notify_all();
+        }
+        worker.join();
+        errcnt += errcntWorker;
+        errstr += errstrWorker;
+    }
+    return stats;
 }
 
 // Stops the signal generation
 void GF1Device::stop(int &errcnt, std::string &errstr)
 {
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes (since version 1.1.0)
+    cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use (since version 1.1.0)
     clearCtrlInterrupt(errcnt, errstr);  // Clear "CTRL" and "INTERRUPT" signals
     toggleInterrupt(errcnt, errstr);  // Toggle "INTERRUPT" signal
+    cp2130_.endGPIOBatch(errcnt, errstr);  // Send any pending GPIO writes
+    cp2130_.endTransferBatch(errcnt, errstr);  // Wait for any pending transfers to complete
+    checkWatchdog(errcnt, errstr);  // Recover the device proactively, if required (since version 1.1.0)
+}
+
+// Takes over a device handed off by another process via handOff() (added in version 1.1.0)
+// The output keeps running, but its state is unknown to this process, so the next operation writes every register
+// See CP2130::takeOver() for details
+int GF1Device::takeOver(int socket, uint8_t backend)
+{
+    Access access(*this);
+    int retval = cp2130_.takeOver(socket, backend);
+    if (retval == SUCCESS) {
+        forgetState();
+    }
+    return retval;
+}
+
+// Releases the exclusive access obtained via lock(), serving the next waiting operation (added in version 1.1.0)
+void GF1Device::unlock()
+{
+    std::lock_guard<std::mutex> guard(queueMutex_);
+    holder_ = std::thread::id();
+    serveNext();
+}
+
+// Waits for the armed trigger to fire, for up to the given timeout (in ms), and then starts the output (added in version 1.1.0)
+// The trigger pin is sampled as fast as the bridge allows, with back-to-back Get_GPIO_Values requests, and the CTRL signal is raised as soon as the edge is detected, via a pre-built request
+// Returns true if the trigger fired, after disarming it, or false if the timeout expired or an error occurred before the CTRL signal was raised, in which case the trigger remains armed
+// Note that if only lowering the CTRL signal fails, the output did start, so the trigger is still deemed fired, and the error is reported via "errcnt" and "errstr"
+bool GF1Device::waitTrigger(int timeout, int &errcnt, std::string &errstr)
+{
+    Access access(*this);
+    CP2130::Profiler::Scope profile(profiler_, cp2130_, __func__);
+    bool fired = false;
+    if (!trigger_.armed) {
+        ++errcnt;
+        errstr += "In waitTrigger(): Trigger is not armed.\n";  // Program logic error
+    } else {
+        int errcntWait = 0;
+        std::chrono::steady_clock::time_point deadline = timeSource().now() + std::chrono::milliseconds(timeout);
+        std::chrono::steady_clock::time_point lastPoll = timeSource().now();
+        while (errcntWait == 0) {
+            bool level = (trigger_.bitmap & cp2130_.getGPIOs(errcntWait, errstr)) != 0x0000;
+            std::chrono::steady_clock::time_point detection = timeSource().now();
+            ++trgstats_.polls;
+            trgstats_.period.add(std::chrono::duration<double, std::micro>(detection - lastPoll).count());
+            lastPoll = detection;
+            if (errcntWait == 0 && level != trigger_.level && (trigger_.edge == TRGBOTH || level == (trigger_.edge == TRGRISING))) {
+                cp2130_.controlTransfer(CP2130::SET, CP2130::SET_GPIO_VALUES, 0x0000, 0x0000, trigger_.fire, CP2130::SET_GPIO_VALUES_WLEN, errcntWait, errstr);  // Raise "CTRL" signal
+                if (errcntWait == 0) {  // Otherwise, the output is not known to have started, so the trigger is left armed and nothing is recorded
+                    timeline_ = programmed_;  // The output now follows the programmed registers
+                    timeline_.anchor = timeSource().now();  // Anchor the timeline of the output to the rising edge of the CTRL signal
+                    trgstats_.latency.add(std::chrono::duration<double, std::micro>(timeline_.anchor - detection).count());
+                    ++trgstats_.fired;
+                    trigger_.armed = false;
+                    fired = true;
+                    cp2130_.controlTransfer(CP2130::SET, CP2130::SET_GPIO_VALUES, 0x0000, 0x0000, trigger_.release, CP2130::SET_GPIO_VALUES_WLEN, errcntWait, errstr);  // Lower "CTRL" signal
+                }
+                break;
+            }
+            trigger_.level = level;
+            if (detection >= deadline) {
+                ++trgstats_.timeouts;
+                break;
+            }
+        }
+        errcnt += errcntWait;
+    }
+    return fired;
+}
+
+// Returns the device having the given serial number, as shared by every caller within the process, opening it if required (added in version 1.1.0)
+// If no serial number is given, the first listed device is returned (see listDevices()). Either way, the registry is keyed by the actual serial number of the device, so that every caller gets the same object for the same device
+// Every operation of the returned device is serialized through its queue, as a normal priority operation from the default submitter (see lock()), unless the calling thread holds the device already. Thus, a sequence of operations can be kept together, or given another priority class or submitter, by calling lock() beforehand
+// Each call counts as a holder, and close() only closes the device once every holder has closed it. Either way, the device is closed once the last holder lets go of it
+// The variable "retval" is set to the same values returned by open(), and a null pointer is returned in case of failure
+std::shared_ptr<GF1Device> GF1Device::acquire(const std::string &serial, int &retval, uint8_t backend)
+{
+    std::lock_guard<std::mutex> guard(registryMutex);  // Held while opening, so that concurrent callers never open the same device twice
+    std::string key = serial;
+    if (key.empty()) {  // The first device is resolved beforehand, since it cannot be opened again if it is already held
+        int errcnt = 0;
+        std::string errstr;
+        std::list<std::string> serials = listDevices(errcnt, errstr);
+        if (!serials.empty()) {
+            key = serials.front();
+        }
+    }
+    std::map<std::string, std::weak_ptr<GF1Device>>::iterator entry = registry.find(key);
+    std::shared_ptr<GF1Device> device = entry == registry.end() ? nullptr : entry->second.lock();
+    if (device == nullptr) {
+        device = std::make_shared<GF1Device>();
+    }
+    if (device->isOpen()) {
+        retval = SUCCESS;
+    } else {  // The device is new to the registry, or was closed by every holder
+        retval = device->open(key, backend);
+        if (retval == SUCCESS) {  // The serial number is read back from the device, in case it could not be resolved beforehand
+            int errcnt = 0;
+            std::string errstr;
+            std::u16string descriptor = device->getSerialDesc(errcnt, errstr);
+            if (errcnt == 0 && !descriptor.empty()) {
+                key.clear();
+                for (char16_t character : descriptor) {  // Convert the descriptor to ASCII, as CP2130::listDevices() does
+                    key += character < 0x80 ? static_cast<char>(character) : '?';
+                }
+            }
+        }
+    }
+    if (retval == SUCCESS) {
+        registry[key] = device;
+        device->shared_ = true;  // Set before the device is returned to any other holder
+        std::lock_guard<std::mutex> queueGuard(device->queueMutex_);
+        ++device->claims_;
+    } else {
+        device = nullptr;
+    }
+    for (std::map<std::string, std::weak_ptr<GF1Device>>::iterator it = registry.begin(); it != registry.end();) {  // Purge expired entries
+        if (it->second.expired()) {
+            it = registry.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return device;
 }
 
 // Helper function that returns the expected amplitude from a given amplitude value
@@ -292,9 +1903,7 @@ std::string GF1Device::hardwareRevision(const CP2130::USBConfig &config)
         revision += static_cast<char>(config.majrel + 'A' - 2);  // Append major revision letter (a major release number value of 2 corresponds to the letter "A" and so on)
     }
     if (config.majrel == 1 || config.minrel != 0) {
-        std::ostringstream stream;
-        stream << static_cast<int>(config.minrel);
-        revision += stream.str();  // Append minor revision number
+        revision += std::to_string(config.minrel);  // Append minor revision number (std::to_string() is used instead of a string stream since version 1.1.0, so that no iostreams are required)
     }
     return revision;
 }
@@ -304,3 +1913,133 @@ std::list<std::string> GF1Device::listDevices(int &errcnt, std::string &errstr)
 {
     return CP2130::listDevices(VID, PID, errcnt, errstr);
 }
+
+// Plays a hop program on each of the given devices, against a single timeline that starts "lead" seconds from now (added in version 1.1.0)
+// Each program is a list of hops sorted by time, and programs[i] is played on devices[i]. The devices must be open and distinct, and must not be locked by the calling thread
+// Each worker locks its device as a critical operation (see lock()) for the whole program, so that devices shared with other threads or subsystems (see acquire()) are not disturbed while playing
+// All frames are encoded beforehand, and each device is driven by its own worker thread, which stages the next hop right after the current one, and then waits for its absolute deadline to toggle CTRL
+// The lead time should cover the staging of the first hop on every device. As in stepThrough(), the waveform is kept if known (otherwise it is set to sinusoidal), and the amplitude is left as is
+// Each device stops on its first error, or once cancel() is called on it. Returns the alignment error of every hop that was played, along with the cross-board skew
+// Each device follows its own clock (see CP2130::getTimeSource()). Devices following virtual time, such as emulated ones, play against a timeline of their own, whose alignment errors are exact, but are left out of the cross-board skew, since their clocks are unrelated
+GF1Device::HopStats GF1Device::playHops(const std::vector<GF1Device *> &devices, const std::vector<std::vector<Hop>> &programs, double lead, int &errcnt, std::string &errstr)
+{
+    HopStats stats;
+    bool valid = true;
+    bool sorted = true;
+    for (size_t i = 0; i < programs.size(); ++i) {
+        for (size_t j = 0; j < programs[i].size(); ++j) {
+            valid = valid && programs[i][j].frequency >= FREQUENCY_MIN && programs[i][j].frequency <= FREQUENCY_MAX;
+            sorted = sorted && programs[i][j].time >= 0 && (j == 0 || programs[i][j].time >= programs[i][j - 1].time);
+        }
+    }
+    bool distinct = true;
+    for (size_t i = 0; i < devices.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            distinct = distinct && devices[i] != devices[j];
+        }
+    }
+    if (devices.size() != programs.size()) {
+        ++errcnt;
+        errstr += "In playHops(): The number of programs must match the number of devices.\n";  // Program logic error
+    } else if (std::find(devices.begin(), devices.end(), nullptr) != devices.end() || !distinct) {
+        ++errcnt;
+        errstr += "In playHops(): Devices must be distinct and not null.\n";  // Program logic error
+    } else if (!valid) {
+        ++errcnt;
+        errstr += "In playHops(): Frequencies must be between 0 and 25000.\n";  // Program logic error
+    } else if (!sorted || lead < 0) {
+        ++errcnt;
+        errstr += "In playHops(): Hop times must be non-negative and sorted, and the lead time must be non-negative.\n";  // Program logic error
+    } else {
+        size_t count = devices.size();
+        std::vector<std::vector<CompiledPreset>> points(count);
+        stats.errors.resize(count);
+        std::vector<std::vector<std::chrono::steady_clock::time_point>> fired(count);  // Rising edges of CTRL, used to work out the cross-board skew
+        std::vector<int> errcnts(count, 0);
+        std::vector<std::string> errstrs(count);
+        std::vector<char> cancelled(count, false);  // Set by each worker separately, in order to avoid a data race
+        std::vector<std::thread> workers;
+        std::chrono::steady_clock::duration leadDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(lead));
+        std::chrono::steady_clock::time_point start = TimeSource::steady().now() + leadDuration;  // Shared timeline of the devices that follow real time
+        std::vector<std::chrono::steady_clock::time_point> starts(count);
+        std::vector<char> virtuals(count);
+        for (size_t i = 0; i < count; ++i) {
+            virtuals[i] = devices[i]->timeSource().isVirtual();
+            starts[i] = virtuals[i] ? devices[i]->timeSource().now() + leadDuration : start;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            workers.push_back(std::thread([&, i] {
+                GF1Device &device = *devices[i];
+                device.lock(PRIOCRITICAL);  // Wait for exclusive access to the device
+                device.clearCancel();  // Only requests made since the device was locked are honored
+                uint8_t waveform = device.waveformKnown_ ? device.waveform_ : WFSINE;
+                points[i].reserve(programs[i].size());
+                for (const Hop &hop : programs[i]) {  // Pre-encode every hop, so that no encoding takes place while playing (the state of the device is only read once it is locked)
+                    points[i].push_back(compilePreset(waveform, frequencyCode(hop.frequency), device.amplitudeCode_));
+                }
+                if (!points[i].empty()) {
+                    device.cp2130_.beginGPIOBatch();  // Combine consecutive GPIO writes
+                    device.cp2130_.beginTransferBatch();  // Submit consecutive transfers without waiting for each one to complete, if the usbfs backend is in use
+                    device.clearCtrlInterrupt(errcnts[i], errstrs[i]);  // Clear "CTRL" and "INTERRUPT" signals
+                    device.toggleInterrupt(errcnts[i], errstrs[i]);  // Toggle "INTERRUPT" signal, in order to terminate any sweep in progress
+                    device.stageFrequency(points[i][0], errcnts[i], errstrs[i]);  // Stage the first hop
+                    device.cp2130_.endGPIOBatch(errcnts[i], errstrs[i]);  // Send any pending GPIO writes
+                    device.cp2130_.endTransferBatch(errcnts[i], errstrs[i]);  // Wait for any pending transfers to complete
+                }
+                for (size_t j = 0; j < points[i].size() && errcnts[i] == 0; ++j) {  // Stop on the first error
+                    if (device.cancelRequested_) {
+                        cancelled[i] = true;
+                        break;
+                    }
+                    std::chrono::steady_clock::time_point deadline = starts[i] + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(programs[i][j].time));
+                    device.timeSource().sleepUntil(deadline);
+                    device.cp2130_.beginGPIOBatch();
+                    device.toggleCtrl(errcnts[i], errstrs[i]);  // Toggle "CTRL" signal, which makes the staged hop take effect
+                    device.cp2130_.endGPIOBatch(errcnts[i], errstrs[i]);
+                    fired[i].push_back(device.timeline_.anchor);
+                    stats.errors[i].push_back(std::chrono::duration<double, std::micro>(device.timeline_.anchor - deadline).count());
+                    if (j + 1 < points[i].size()) {
+                        device.stageFrequency(points[i][j + 1], errcnts[i], errstrs[i]);  // Stage the next hop, which only takes effect on the next toggle of CTRL
+                    }
+                }
+                device.unlock();
+            }));
+        }
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        std::map<double, std::pair<std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point>> edges;  // Earliest and latest rising edges of CTRL, indexed by hop time
+        std::map<double, size_t> boards;  // Number of devices hopping at each hop time
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t j = 0; j < fired[i].size(); ++j) {
+                stats.alignment.add(stats.errors[i][j]);
+                ++stats.hops;
+                double time = programs[i][j].time;
+                if (virtuals[i]) {  // Skew is only meaningful between devices following real time
+                    continue;
+                }
+                if (boards[time]++ == 0) {
+                    edges[time] = std::make_pair(fired[i][j], fired[i][j]);
+                } else {
+                    edges[time].first = std::min(edges[time].first, fired[i][j]);
+                    edges[time].second = std::max(edges[time].second, fired[i][j]);
+                }
+            }
+            errcnt += errcnts[i];
+            errstr += errstrs[i];
+            stats.cancelled = stats.cancelled || cancelled[i];
+        }
+        for (const auto &edge : edges) {
+            if (boards[edge.first] > 1) {  // Skew is only defined if at least two devices hop at the same time
+                stats.skew.add(std::chrono::duration<double, std::micro>(edge.second.second - edge.second.first).count());
+            }
+        }
+    }
+    return stats;
+}
+
+// Helper function that returns the total duration (in us) of a given sweep, from its start until the final frequency is reached (added in version 1.1.0)
+double GF1Device::sweepDuration(const Sweep &sweep)
+{
+    return static_cast<double>(sweep.nincr) * sweep.tint * TINTMULTIPLIERS[0x03 & sweep.tintmult] * 1000 / MCLK;
+}
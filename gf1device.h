@@ -1,5 +1,5 @@
-/* GF1 device class - Version 1.0.1
-   Requires CP2130 class version 1.1.0 or later
+/* GF1 device class - Version 1.1.0
+   Requires CP2130 class version 1.3.0 or later
    Copyright (c) 2022 Samuel Lourenço
 
    This library is free software: you can redistribute it and/or modify it
@@ -23,20 +23,152 @@
 #define GF1DEVICE_H
 
 // Includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include "cp2130.h"
 
 class GF1Device
 {
+public:
+    struct TriggerStats {
+        uint64_t fired;                // Number of times the trigger fired
+        uint64_t timeouts;             // Number of calls to waitTrigger() that timed out
+        uint64_t polls;                // Number of times the trigger pin was sampled
+        CP2130::LatencyStats latency;  // Detect-to-fire latency statistics (from the detection of the edge to the rising edge of CTRL)
+        CP2130::LatencyStats period;   // Polling period statistics (the edge may take place at any point within the last period)
+
+        TriggerStats();
+    };
+
+    struct SchedulerPolicy {
+        double targets[3];  // Queueing delay targets (in us), indexed by priority class, beyond which a waiting operation is served ahead of any other that is still within its own target
+
+        SchedulerPolicy();
+    };
+
+    struct SchedulerStats {
+        CP2130::LatencyStats delay[3];  // Queueing delay statistics, indexed by priority class (from the call to lock() until access is granted)
+        uint64_t missed[3];             // Number of operations that waited longer than the target of their priority class, indexed by priority class
+
+        SchedulerStats();
+    };
+
+    struct LevelingPoint {
+        float frequency;  // Frequency (in KHz)
+        float amplitude;  // Amplitude (in Vpp) that yields the desired output level at the above frequency
+    };
+
+    struct Sweep {
+        float start;       // Start frequency (in KHz)
+        float delta;       // Delta frequency, added at each increment (in KHz, negative for a downward sweep)
+        uint16_t nincr;    // Number of increments
+        uint16_t tint;     // Increment interval (in MCLK periods, before multiplication)
+        uint8_t tintmult;  // Increment interval multiplier
+
+        bool operator ==(const Sweep &other) const;
+        bool operator !=(const Sweep &other) const;
+    };
+
 private:
+    struct Timeline {
+        bool active;                                    // True if the output is being generated (or, regarding the programmed registers, true if these are known)
+        std::chrono::steady_clock::time_point anchor;   // Host timestamp of the CTRL toggle that started the output
+        uint32_t start;                                 // Start frequency code
+        int32_t delta;                                  // Delta frequency code (signed)
+        uint16_t nincr;                                 // Number of increments
+        double tint;                                    // Increment interval (in us)
+    };
+
+    struct Waiter {
+        uint64_t ticket;                                // Ticket that identifies the waiting operation
+        uint8_t prioclass;                              // Priority class
+        double finish;                                  // Virtual finish time, as per self-clocked fair queuing
+        std::chrono::steady_clock::time_point arrival;  // Time at which lock() was called
+    };
+
+    struct CompiledPreset {
+        uint8_t waveform;                     // Waveform
+        uint32_t frequencyCode;               // Start frequency code
+        uint8_t amplitudeCode;                // Amplitude code
+        std::vector<uint8_t> frequencyFrame;  // Frame to be written to the AD5932 waveform generator (control register, followed by the frequency registers)
+        std::vector<uint8_t> amplitudeFrame;  // Frame to be written to the AD5160 SPI potentiometer
+    };
+
+    struct Trigger {
+        bool armed;                                           // True if the trigger is armed
+        uint16_t bitmap;                                      // Bitmap of the trigger pin
+        uint8_t edge;                                         // Trigger edge
+        bool level;                                           // Last sampled level of the trigger pin
+        unsigned char fire[CP2130::SET_GPIO_VALUES_WLEN];     // Pre-built Set_GPIO_Values data stage that raises the CTRL signal
+        unsigned char release[CP2130::SET_GPIO_VALUES_WLEN];  // Pre-built Set_GPIO_Values data stage that lowers the CTRL signal
+    };
+
+    class Access
+    {
+    private:
+        GF1Device &device_;
+        bool locked_;
+
+    public:
+        explicit Access(GF1Device &device);
+        ~Access();
+    };
+
     CP2130 cp2130_;
+    Timeline programmed_, timeline_;
+    uint8_t cfrq0_, cfrq1_;
+    bool waveformKnown_, amplitudeKnown_;
+    uint8_t waveform_, amplitudeCode_;
+    std::vector<CompiledPreset> presets_;
+    Trigger trigger_;
+    TriggerStats trgstats_;
+    mutable std::mutex queueMutex_;
+    std::condition_variable queueCond_;
+    uint64_t nextTicket_, servingTicket_;
+    bool queueBusy_;
+    uint8_t servingClass_;
+    std::atomic<bool> cancelRequested_;
+    std::thread::id holder_;
+    std::atomic<bool> shared_;
+    uint32_t claims_;
+    double queueVirtual_;
+    std::list<Waiter> waiters_;
+    std::map<uint32_t, double> submitterFinish_, submitterWeights_;
+    SchedulerPolicy schpolicy_;
+    SchedulerStats schstats_;
+    std::chrono::steady_clock::time_point lastRecovery_;
+    std::vector<LevelingPoint> leveling_;
+    CP2130::Profiler profiler_;
 
+    TimeSource &timeSource() const;
+
+    void checkWatchdog(int &errcnt, std::string &errstr);
+    void clearCancel();
     void clearCtrlInterrupt(int &errcnt, std::string &errstr);
+    void forgetState();
+    void serveNext();
+    void stageAmplitude(uint8_t code, int &errcnt, std::string &errstr);
+    void stageFrequency(const CompiledPreset &point, int &errcnt, std::string &errstr);
+    bool stagePreset(const CompiledPreset &preset, bool diff, bool force, int &errcnt, std::string &errstr);
     void toggleCtrl(int &errcnt, std::string &errstr);
     void toggleInterrupt(int &errcnt, std::string &errstr);
 
+    static uint8_t amplitudeCode(float amplitude);
+    static CompiledPreset compilePreset(uint8_t waveform, uint32_t frequencyCode, uint8_t amplitudeCode);
+    static uint32_t frequencyCode(float frequency);
+    static uint64_t residentSetSize();
+    static std::string sweepError(const Sweep &sweep);
+
 public:
     // Class definitions
     static const uint16_t VID = 0x10c4;                          // USB vendor ID
@@ -46,6 +178,15 @@ public:
     static const int ERROR_NOT_FOUND = CP2130::ERROR_NOT_FOUND;  // Returned by open() if the device was not found
     static const int ERROR_BUSY = CP2130::ERROR_BUSY;            // Returned by open() if the device is already in use
 
+    // The following values are applicable to open() (added in version 1.1.0)
+    static const uint8_t BACKEND_LIBUSB = CP2130::BACKEND_LIBUSB;  // Transfers are carried out via libusb
+    static const uint8_t BACKEND_USBFS = CP2130::BACKEND_USBFS;    // Transfers are carried out via direct URB submission to usbfs (Linux only)
+
+    // The following values are applicable to lock() (added in version 1.1.0)
+    static const uint8_t PRIOCRITICAL = 0x00;    // Critical operations, such as the updates issued by a control loop
+    static const uint8_t PRIONORMAL = 0x01;      // Normal operations (default)
+    static const uint8_t PRIOBACKGROUND = 0x02;  // Background operations, such as monitoring or logging queries
+
     // Limits applicable to setAmplitude()
     static constexpr float AMPLITUDE_MIN = 0;  // Minimum amplitude
     static constexpr float AMPLITUDE_MAX = 5;  // Maximum amplitude
@@ -54,34 +195,221 @@ public:
     static constexpr float FREQUENCY_MIN = 0;      // Minimum frequency
     static constexpr float FREQUENCY_MAX = 25000;  // Maximum frequency
 
+    // The following values are applicable to Preset/addPreset()
+    static const uint8_t WFSINE = 0x00;      // Sinusoidal waveform
+    static const uint8_t WFTRIANGLE = 0x01;  // Triangular waveform
+
+    // The following values are applicable to estimateDuration()
+    static const uint8_t OPCLEAR = 0x00;         // Corresponds to clear()
+    static const uint8_t OPSETAMPLITUDE = 0x01;  // Corresponds to setAmplitude()
+    static const uint8_t OPSETFREQUENCY = 0x02;  // Corresponds to setFrequency()
+    static const uint8_t OPSETSWEEP = 0x03;      // Corresponds to setSweep()
+    static const uint8_t OPSETWAVE = 0x04;       // Corresponds to setSineWave() or setTriangleWave()
+    static const uint8_t OPSTART = 0x05;         // Corresponds to start()
+    static const uint8_t OPSTOP = 0x06;          // Corresponds to stop()
+
+    // The following values are applicable to armTrigger()
+    static const uint8_t TRGRISING = 0x00;   // Trigger on the rising edge
+    static const uint8_t TRGFALLING = 0x01;  // Trigger on the falling edge
+    static const uint8_t TRGBOTH = 0x02;     // Trigger on both edges
+
+    // Limits applicable to setSweep()
+    static const uint16_t NINCR_MIN = 2;     // Minimum number of increments
+    static const uint16_t NINCR_MAX = 4095;  // Maximum number of increments
+    static const uint16_t TINT_MIN = 2;      // Minimum increment interval (in MCLK periods, before multiplication)
+    static const uint16_t TINT_MAX = 2047;   // Maximum increment interval (in MCLK periods, before multiplication)
+
+    // The following values are applicable to Sweep/setSweep()
+    static const uint8_t TINTMULT1 = 0x00;    // Increment interval multiplied by 1
+    static const uint8_t TINTMULT5 = 0x01;    // Increment interval multiplied by 5
+    static const uint8_t TINTMULT100 = 0x02;  // Increment interval multiplied by 100
+    static const uint8_t TINTMULT500 = 0x03;  // Increment interval multiplied by 500
+
+    struct Preset {
+        uint8_t waveform;  // Waveform (see the values applicable to Preset/addPreset())
+        float frequency;   // Frequency (in KHz)
+        float amplitude;   // Amplitude (in Vpp)
+
+        bool operator ==(const Preset &other) const;
+        bool operator !=(const Preset &other) const;
+    };
+
+    struct StepStats {
+        size_t points;                  // Number of points that were stepped through
+        double elapsed;                 // Time taken, from the first step to the end of the last acquisition (in s)
+        double rate;                    // Achieved rate (in points per second)
+        CP2130::LatencyStats steplat;   // Step latency statistics (each step only requires the CTRL toggle, on its critical path)
+        CP2130::LatencyStats stagelat;  // Staging latency statistics (the next point is staged while the current one is being acquired)
+        bool cancelled;                 // True if stepping was cancelled via cancel() (or preempted by a critical operation) before the last point
+
+        StepStats();
+    };
+
+    struct LevelingStats {
+        size_t updates;                 // Number of amplitude updates that were written
+        size_t skipped;                 // Number of increments that were skipped, because the following increment was already due
+        CP2130::LatencyStats lateness;  // Lateness statistics (from the start of each increment to the moment its amplitude update was written)
+        bool cancelled;                 // True if leveling was cancelled via cancel() (or preempted by a critical operation) before the last increment
+        bool interrupted;               // True if leveling stopped because the output no longer followed the programmed sweep (e.g., the device was recovered meanwhile)
+
+        LevelingStats();
+    };
+
+    struct Hop {
+        double time;      // Time of the hop (in s), relative to the start of the shared timeline
+        float frequency;  // Frequency (in KHz)
+    };
+
+    struct HopStats {
+        std::vector<std::vector<double>> errors;  // Alignment error of each hop that was played (in us, from its deadline on the shared timeline to the rising edge of CTRL), indexed by device and then by hop
+        CP2130::LatencyStats alignment;           // Alignment error statistics, covering every hop of every device
+        CP2130::LatencyStats skew;                // Cross-board skew statistics (in us, from the earliest to the latest rising edge of CTRL among the devices hopping at the same time)
+        size_t hops;                              // Number of hops that were played, across all devices
+        bool cancelled;                           // True if any device was cancelled via cancel() (or preempted by a critical operation) before its last hop
+
+        HopStats();
+    };
+
+    struct Glide {
+        float startFrequency;   // Start frequency (in KHz)
+        float targetFrequency;  // Target frequency (in KHz), which can be equal to the start frequency, in order for the frequency to be left untouched
+        float startAmplitude;   // Start amplitude (in Vpp)
+        float targetAmplitude;  // Target amplitude (in Vpp), which can be equal to the start amplitude, in order for the amplitude to be left untouched
+        double duration;        // Duration of the glide (in s)
+    };
+
+    struct GlideStats {
+        size_t updates;              // Number of updates that were written (an update may set the frequency, the amplitude, or both)
+        double elapsed;              // Time taken, from the start of the glide to the end of the last update (in s)
+        double lateness;             // Time by which the last update ended after the end of the glide (in us, negative if it ended early)
+        CP2130::LatencyStats updlat;  // Update latency statistics
+        bool cancelled;               // True if the glide was cancelled via cancel() (or preempted by a critical operation) before its last update
+
+        GlideStats();
+    };
+
+    struct SoakPolicy {
+        uint64_t operations;  // Number of operations to carry out
+        uint64_t interval;    // Number of operations between samples
+        uint32_t seed;        // Seed of the pseudo-random sequence of operations, so that a run can be reproduced
+        double rssdrift;      // Growth of the resident set size (in KiB), relative to the first sample, beyond which drift is flagged
+        double bufdrift;      // Number of transfer buffer growths per operation beyond which drift is flagged
+        double allocdrift;    // Growth of the number of heap allocations per operation, relative to the first sample, beyond which drift is flagged (only applicable if "alloccounter" is set)
+        double latdrift;      // Ratio of the 99th percentile latency to that of the first sample beyond which drift is flagged
+        std::function<uint64_t()> alloccounter;  // Optional hook that returns the number of heap allocations made by the process so far, typically counted by a replacement of the global operator new (heap allocations are not counted if not set)
+
+        SoakPolicy();
+    };
+
+    struct SoakSample {
+        uint64_t operations;  // Number of operations carried out so far
+        double elapsed;       // Time elapsed since the start of the run (in s)
+        uint64_t rss;         // Resident set size (in KiB), as given by "/proc/self/statm" (zero if not available)
+        uint64_t bufallocs;   // Number of times that the reusable transfer buffer had to grow during the interval (this is not a count of heap allocations)
+        uint64_t heapallocs;  // Number of heap allocations during the interval, as given by the allocation counter of the soak policy (zero if not set)
+        uint64_t errors;      // Number of operations that failed during the interval
+        double p50;           // Median operation latency over the interval (in us)
+        double p99;           // 99th percentile operation latency over the interval (in us)
+        double max;           // Maximum operation latency over the interval (in us)
+        bool drift;           // True if any of the thresholds given by the soak policy was exceeded
+    };
+
+    struct SoakStats {
+        SoakSample baseline;           // First sample, against which drift is measured
+        SoakSample last;               // Last sample
+        uint64_t operations;           // Number of operations carried out
+        uint64_t errors;               // Number of operations that failed
+        uint64_t drifts;               // Number of samples that flagged drift
+        CP2130::LatencyStats latency;  // Operation latency statistics, covering the whole run
+        bool cancelled;                // True if the run was cancelled via cancel() (or preempted by a critical operation) before its last operation
+
+        SoakStats();
+    };
+
     GF1Device();
 
     bool disconnected() const;
+    double estimateDuration(uint8_t operation, int &errcnt, std::string &errstr) const;
+    float frequencyAt(std::chrono::steady_clock::time_point time) const;
+    CP2130::IdlePolicy getIdlePolicy() const;
+    std::map<std::string, CP2130::OperationProfile> getOperationProfiles() const;
+    SchedulerPolicy getSchedulerPolicy() const;
+    SchedulerStats getSchedulerStats() const;
+    CP2130::TimingModel getTimingModel() const;
+    CP2130::TransferStats getTransferStats() const;
+    TriggerStats getTriggerStats() const;
+    CP2130::WatchdogPolicy getWatchdogPolicy() const;
+    CP2130::WatchdogStatus getWatchdogStatus() const;
+    float instantaneousFrequency() const;
     bool isOpen() const;
+    bool isProfiling() const;
+    bool isSweeping() const;
+    bool isTriggerArmed() const;
+    float leveledAmplitude(float frequency) const;
+    size_t presetCount() const;
 
+    void addPreset(const Preset &preset, int &errcnt, std::string &errstr);
+    void armTrigger(size_t index, uint8_t pin, uint8_t edge, int &errcnt, std::string &errstr);
+    void armTrigger(uint8_t pin, uint8_t edge, int &errcnt, std::string &errstr);
+    void calibrateTimingModel();
+    void cancel();
     void clear(int &errcnt, std::string &errstr);
+    void clearLevelingTable();
+    void clearPresets();
     void close();
+    void disarmTrigger();
     CP2130::SiliconVersion getCP2130SiliconVersion(int &errcnt, std::string &errstr);
     std::string getHardwareRevision(int &errcnt, std::string &errstr);
     std::u16string getManufacturerDesc(int &errcnt, std::string &errstr);
     std::u16string getProductDesc(int &errcnt, std::string &errstr);
     std::u16string getSerialDesc(int &errcnt, std::string &errstr);
     CP2130::USBConfig getUSBConfig(int &errcnt, std::string &errstr);
-    int open(const std::string &serial = std::string());
+    GlideStats glide(const Glide &glide, int &errcnt, std::string &errstr);
+    void handOff(int socket, int &errcnt, std::string &errstr);
+    void lock();
+    void lock(uint8_t prioclass, uint32_t submitter = 0, double cost = 1);
+    int open(const std::string &serial = std::string(), uint8_t backend = BACKEND_LIBUSB);
+    int openTransport(CP2130::Transport *transport);
+    void recallPreset(size_t index, bool diff, int &errcnt, std::string &errstr);
+    int recover(int &errcnt, std::string &errstr);
     void reset(int &errcnt, std::string &errstr);
+    void resetOperationProfiles();
+    void resetSchedulerStats();
+    void resetTransferStats();
+    void resetTriggerStats();
+    void resetWatchdog();
     void setAmplitude(float amplitude, int &errcnt, std::string &errstr);
     void setFrequency(float frequency, int &errcnt, std::string &errstr);
+    void setIdlePolicy(const CP2130::IdlePolicy &policy, int &errcnt, std::string &errstr);
+    LevelingStats setLeveledSweep(const Sweep &sweep, int &errcnt, std::string &errstr);
+    void setLevelingTable(const std::vector<LevelingPoint> &table, int &errcnt, std::string &errstr);
+    void setProfiling(bool enabled);
+    void setSchedulerPolicy(const SchedulerPolicy &policy);
     void setSineWave(int &errcnt, std::string &errstr);
+    void setSubmitterWeight(uint32_t submitter, double weight, int &errcnt, std::string &errstr);
+    void setSweep(const Sweep &sweep, int &errcnt, std::string &errstr);
+    void setTimingModel(const CP2130::TimingModel &model);
     void setTriangleWave(int &errcnt, std::string &errstr);
+    void setWatchdogPolicy(const CP2130::WatchdogPolicy &policy);
+    void setupChannel0(uint8_t cfrq, int &errcnt, std::string &errstr);
     void setupChannel0(int &errcnt, std::string &errstr);
+    void setupChannel1(uint8_t cfrq, int &errcnt, std::string &errstr);
     void setupChannel1(int &errcnt, std::string &errstr);
+    SoakStats soak(const SoakPolicy &policy, const std::function<bool(const SoakSample &sample)> &report, int &errcnt, std::string &errstr);
     void start(int &errcnt, std::string &errstr);
+    StepStats stepThrough(const std::vector<float> &frequencies, const std::function<bool(size_t index, float frequency)> &acquire, int &errcnt, std::string &errstr);
     void stop(int &errcnt, std::string &errstr);
+    int takeOver(int socket, uint8_t backend = BACKEND_LIBUSB);
+    void unlock();
+    bool waitTrigger(int timeout, int &errcnt, std::string &errstr);
 
+    static std::shared_ptr<GF1Device> acquire(const std::string &serial, int &retval, uint8_t backend = BACKEND_LIBUSB);
     static float expectedAmplitude(float amplitude);
     static float expectedFrequency(float frequency);
     static std::string hardwareRevision(const CP2130::USBConfig &config);
     static std::list<std::string> listDevices(int &errcnt, std::string &errstr);
+    static HopStats playHops(const std::vector<GF1Device *> &devices, const std::vector<std::vector<Hop>> &programs, double lead, int &errcnt, std::string &errstr);
+    static double sweepDuration(const Sweep &sweep);
 };
 
 #endif  // GF1DEVICE_H
@@ -0,0 +1,100 @@
+/* Time source class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <cmath>
+#include <thread>
+#include "timesource.h"
+
+// Each clock starts in real time, following std::chrono::steady_clock, and can be made virtual via setVirtual()
+// Virtual time is thus confined to whatever uses the given clock (e.g., an emulated device, see CP2130Emulator::getTimeSource()), whereas real devices keep using steady()
+TimeSource::TimeSource() :
+    virtual_(false),  // True if the virtual clock is in use
+    virtualNow_(0)    // Current virtual time (in ns since the epoch of std::chrono::steady_clock)
+{
+}
+
+// Checks if the virtual clock is in use
+bool TimeSource::isVirtual() const
+{
+    return virtual_;
+}
+
+// Returns the current time, as given by the virtual clock if in use, or by std::chrono::steady_clock otherwise
+std::chrono::steady_clock::time_point TimeSource::now() const
+{
+    std::chrono::steady_clock::time_point time;
+    if (virtual_) {
+        time = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(virtualNow_)));
+    } else {
+        time = std::chrono::steady_clock::now();
+    }
+    return time;
+}
+
+// Advances the virtual clock by the given duration (in us), or does nothing if the virtual clock is not in use
+void TimeSource::advance(double duration)
+{
+    if (virtual_ && duration > 0) {
+        virtualNow_ += static_cast<int64_t>(std::llround(1000 * duration));
+    }
+}
+
+// Enables or disables the virtual clock, which only advances via advance(), sleep() or sleepUntil(), and therefore lets long programs run as fast as they can be computed
+// When enabled, the virtual clock starts at the current time, so that time points taken before remain meaningful. Note that the clock returned by steady() always follows real time, and cannot be made virtual
+void TimeSource::setVirtual(bool enabled)
+{
+    if (this != &steady()) {
+        if (enabled && !virtual_) {
+            virtualNow_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+        virtual_ = enabled;
+    }
+}
+
+// Waits for the given duration (in us), which takes no time at all if the virtual clock is in use (the virtual clock advances instead)
+void TimeSource::sleep(double duration)
+{
+    if (virtual_) {
+        advance(duration);
+    } else if (duration > 0) {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(duration));
+    }
+}
+
+// Waits until the given time is reached, which takes no time at all if the virtual clock is in use (the virtual clock is brought forward instead)
+void TimeSource::sleepUntil(std::chrono::steady_clock::time_point time)
+{
+    if (virtual_) {
+        int64_t target = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        int64_t current = virtualNow_;
+        while (current < target && !virtualNow_.compare_exchange_weak(current, target)) {  // The virtual clock never goes back, even if other threads advance it concurrently
+        }
+    } else {
+        std::this_thread::sleep_until(time);
+    }
+}
+
+// Returns the process-wide real time clock, which is used by real devices
+TimeSource &TimeSource::steady()
+{
+    static TimeSource clock;
+    return clock;
+}
@@ -0,0 +1,49 @@
+/* Time source class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef TIMESOURCE_H
+#define TIMESOURCE_H
+
+// Includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+class TimeSource
+{
+private:
+    std::atomic<bool> virtual_;
+    std::atomic<int64_t> virtualNow_;
+
+public:
+    TimeSource();
+
+    bool isVirtual() const;
+    std::chrono::steady_clock::time_point now() const;
+
+    void advance(double duration);
+    void setVirtual(bool enabled);
+    void sleep(double duration);
+    void sleepUntil(std::chrono::steady_clock::time_point time);
+
+    static TimeSource &steady();
+};
+
+#endif  // TIMESOURCE_H